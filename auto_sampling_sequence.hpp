@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "global_parameters.hpp"
+#include "indexed_sequence.hpp"
+#include "util.hpp"
+
+namespace ds2i {
+
+    // Writes BaseSequence with sampling parameters chosen per sequence
+    // instead of index-wide. Long lists are mostly accessed with next_geq,
+    // as they are intersected with shorter ones, so they get denser
+    // pointers; short lists are mostly scanned, and would not use them.
+    // Sequences shorter than header_threshold never have pointers; for
+    // the others the choice is stored in a small header, so the
+    // enumerator does not depend on the policy used at build time.
+    template <typename BaseSequence = indexed_sequence>
+    struct auto_sampling_sequence {
+
+        typedef BaseSequence base_sequence_type;
+        typedef typename base_sequence_type::enumerator base_sequence_enumerator;
+
+        enum sampling_type {
+            no_pointers = 0,
+            default_sampling = 1,
+            dense_sampling = 2,
+            denser_sampling = 3,
+
+            sampling_types = 4
+        };
+
+        static const uint64_t sampling_bits = 2;
+        static const uint64_t header_threshold = 1 << 10;
+
+        static uint64_t header_bits(uint64_t n)
+        {
+            return n < header_threshold ? 0 : sampling_bits;
+        }
+
+        static sampling_type choose_sampling(uint64_t /* universe */, uint64_t n)
+        {
+            if (n < header_threshold) return no_pointers;
+            if (n < (uint64_t(1) << 16)) return default_sampling;
+            if (n < (uint64_t(1) << 20)) return dense_sampling;
+            return denser_sampling;
+        }
+
+        static global_parameters sampling_params(global_parameters params,
+                                                 sampling_type type)
+        {
+            int delta = 0;
+            switch (type) {
+            case no_pointers:
+                params.ef_log_sampling0 = 63;
+                params.ef_log_sampling1 = 63;
+                params.rb_log_rank1_sampling = 63;
+                params.rb_log_sampling1 = 63;
+                return params;
+            case default_sampling:
+                return params;
+            case dense_sampling:
+                delta = 1;
+                break;
+            case denser_sampling:
+                delta = 2;
+                break;
+            default:
+                throw std::invalid_argument("Unsupported sampling type");
+            }
+
+            auto denser = [&](uint8_t& log_sampling) {
+                log_sampling = uint8_t(std::max(int(log_sampling) - delta, 1));
+            };
+            denser(params.ef_log_sampling0);
+            denser(params.ef_log_sampling1);
+            denser(params.rb_log_rank1_sampling);
+            denser(params.rb_log_sampling1);
+            return params;
+        }
+
+        static DS2I_FLATTEN_FUNC uint64_t
+        bitsize(global_parameters const& params, uint64_t universe, uint64_t n)
+        {
+            auto sparams = sampling_params(params, choose_sampling(universe, n));
+            return header_bits(n) + base_sequence_type::bitsize(sparams, universe, n);
+        }
+
+        template <typename Iterator>
+        static void write(succinct::bit_vector_builder& bvb,
+                          Iterator begin,
+                          uint64_t universe, uint64_t n,
+                          global_parameters const& params)
+        {
+            sampling_type type = choose_sampling(universe, n);
+            bvb.append_bits(type, header_bits(n));
+            base_sequence_type::write(bvb, begin, universe, n,
+                                      sampling_params(params, type));
+        }
+
+        class enumerator {
+        public:
+
+            typedef std::pair<uint64_t, uint64_t> value_type; // (position, value)
+
+            enumerator()
+            {}
+
+            enumerator(succinct::bit_vector const& bv, uint64_t offset,
+                       uint64_t universe, uint64_t n,
+                       global_parameters const& params)
+            {
+                sampling_type type = no_pointers;
+                if (header_bits(n)) {
+                    type = sampling_type(bv.get_word56(offset)
+                                         & ((uint64_t(1) << sampling_bits) - 1));
+                }
+                m_base_enum = base_sequence_enumerator(bv, offset + header_bits(n),
+                                                       universe, n,
+                                                       sampling_params(params, type));
+            }
+
+            value_type DS2I_FLATTEN_FUNC move(uint64_t position)
+            {
+                return m_base_enum.move(position);
+            }
+
+            value_type DS2I_FLATTEN_FUNC next_geq(uint64_t lower_bound)
+            {
+                return m_base_enum.next_geq(lower_bound);
+            }
+
+            value_type DS2I_FLATTEN_FUNC next()
+            {
+                return m_base_enum.next();
+            }
+
+            uint64_t size() const
+            {
+                return m_base_enum.size();
+            }
+
+            uint64_t prev_value() const
+            {
+                return m_base_enum.prev_value();
+            }
+
+            base_sequence_enumerator const& base() const
+            {
+                return m_base_enum;
+            }
+
+        private:
+            base_sequence_enumerator m_base_enum;
+        };
+    };
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stdexcept>
+#include <iterator>
+#include <stdint.h>
+
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+
+namespace ds2i {
+
+    // A binary_freq_collection whose postings also carry the occurrences
+    // of the term in each field of the document (for example title, body
+    // and anchor text). The field frequencies are in <basename>.fields,
+    // which starts with a singleton sequence containing the number of
+    // fields F, followed by a sequence of n * F integers for each posting
+    // list of length n, where the F frequencies of each posting are
+    // contiguous. The frequencies in <basename>.freqs must be their sums.
+    class binary_multi_field_collection {
+    public:
+
+        binary_multi_field_collection(const char* basename)
+            : m_coll(basename)
+            , m_fields((std::string(basename) + ".fields").c_str())
+        {
+            auto firstseq = *m_fields.begin();
+            if (firstseq.size() != 1) {
+                throw std::invalid_argument("First sequence should only contain number of fields");
+            }
+            m_num_fields = *firstseq.begin();
+            if (!m_num_fields) {
+                throw std::invalid_argument("Number of fields must be positive");
+            }
+        }
+
+        class iterator;
+
+        iterator begin() const
+        {
+            auto fields_it = m_fields.begin();
+            return iterator(m_coll.begin(), ++fields_it);
+        }
+
+        iterator end() const
+        {
+            return iterator(m_coll.end(), m_fields.end());
+        }
+
+        uint64_t num_docs() const
+        {
+            return m_coll.num_docs();
+        }
+
+        uint64_t num_fields() const
+        {
+            return m_num_fields;
+        }
+
+        struct sequence {
+            binary_collection::sequence docs;
+            binary_collection::sequence freqs;
+            binary_collection::sequence fields;
+        };
+
+        class iterator : public std::iterator<std::forward_iterator_tag,
+                                              sequence> {
+        public:
+            iterator()
+            {}
+
+            value_type const& operator*() const
+            {
+                return m_cur_seq;
+            }
+
+            value_type const* operator->() const
+            {
+                return &m_cur_seq;
+            }
+
+            iterator& operator++()
+            {
+                ++m_coll_it;
+                ++m_fields_it;
+                read();
+                return *this;
+            }
+
+            bool operator==(iterator const& other) const
+            {
+                return m_coll_it == other.m_coll_it;
+            }
+
+            bool operator!=(iterator const& other) const
+            {
+                return !(*this == other);
+            }
+
+        private:
+            friend class binary_multi_field_collection;
+
+            iterator(binary_freq_collection::iterator coll_it,
+                     binary_collection::iterator fields_it)
+                : m_coll_it(coll_it)
+                , m_fields_it(fields_it)
+            {
+                read();
+            }
+
+            void read()
+            {
+                m_cur_seq.docs = m_coll_it->docs;
+                m_cur_seq.freqs = m_coll_it->freqs;
+                m_cur_seq.fields = *m_fields_it;
+            }
+
+            binary_freq_collection::iterator m_coll_it;
+            binary_collection::iterator m_fields_it;
+            sequence m_cur_seq;
+        };
+
+    private:
+        binary_freq_collection m_coll;
+        binary_collection m_fields;
+        uint64_t m_num_fields;
+    };
+}
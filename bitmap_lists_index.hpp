@@ -0,0 +1,272 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+
+#include <succinct/bit_vector.hpp>
+
+#include "compact_elias_fano.hpp"
+#include "configuration.hpp"
+#include "global_parameters.hpp"
+
+namespace ds2i {
+
+    // Adds to the densest lists of BaseIndex a plain bitmap of their
+    // docids, so that conjunctions can test their membership with a
+    // single bit access instead of decoding them (see the and_query
+    // overload in queries.hpp), and intersect lists that all have a
+    // bitmap a word at a time. All the postings are still in BaseIndex,
+    // which provides iteration and frequencies. The lists with at least
+    // num_docs / min_density_inverse postings are candidates, and the
+    // densest ones are given a bitmap as long as the bitmaps fit in
+    // DS2I_BITMAP_BUDGET bytes (unlimited by default). As in
+    // hybrid_lists_index, the ids of the lists with a bitmap are stored
+    // in an Elias-Fano sequence, whose rank gives the bitmap.
+    template <typename BaseIndex>
+    class bitmap_lists_index {
+    public:
+        static const uint64_t min_density_inverse = 8;
+
+        bitmap_lists_index()
+            : m_size(0)
+            , m_num_docs(0)
+            , m_num_bitmaps(0)
+        {}
+
+        class builder {
+        public:
+            builder(uint64_t num_docs, global_parameters const& params)
+                : m_params(params)
+                , m_num_docs(num_docs)
+                , m_size(0)
+                , m_budget(configuration::get().bitmap_budget)
+                , m_base_builder(num_docs, params)
+            {}
+
+            template <typename DocsIterator, typename FreqsIterator>
+            void add_posting_list(uint64_t n, DocsIterator docs_begin,
+                                  FreqsIterator freqs_begin, uint64_t occurrences)
+            {
+                if (!n) throw std::invalid_argument("List must be nonempty");
+                m_base_builder.add_posting_list(n, docs_begin, freqs_begin,
+                                                occurrences);
+                if (n * min_density_inverse >= m_num_docs) {
+                    m_candidates.emplace_back(n, m_size);
+                }
+                m_size += 1;
+            }
+
+            void build(bitmap_lists_index& sq)
+            {
+                sq.m_params = m_params;
+                sq.m_size = m_size;
+                sq.m_num_docs = m_num_docs;
+                m_base_builder.build(sq.m_base);
+
+                // densest lists first
+                std::sort(m_candidates.begin(), m_candidates.end(),
+                          [](std::pair<uint64_t, uint64_t> const& lhs,
+                             std::pair<uint64_t, uint64_t> const& rhs) {
+                              return lhs.first > rhs.first;
+                          });
+                uint64_t stride = sq.bitmap_stride();
+                std::vector<uint64_t> ids;
+                for (auto const& c: m_candidates) {
+                    if (m_budget / (stride / 8) <= ids.size()) break;
+                    ids.push_back(c.second);
+                }
+                std::sort(ids.begin(), ids.end());
+
+                sq.m_num_bitmaps = ids.size();
+                if (ids.empty()) return;
+
+                succinct::bit_vector_builder ids_bvb;
+                compact_elias_fano::write(ids_bvb, ids.begin(),
+                                          m_size, ids.size(), m_params);
+                succinct::bit_vector(&ids_bvb).swap(sq.m_bitmap_ids);
+
+                succinct::bit_vector_builder bitmaps(ids.size() * stride);
+                for (size_t r = 0; r < ids.size(); ++r) {
+                    auto e = sq.m_base[ids[r]];
+                    for (size_t i = 0; i < e.size(); ++i, e.next()) {
+                        bitmaps.set(r * stride + e.docid(), true);
+                    }
+                }
+                succinct::bit_vector(&bitmaps).swap(sq.m_bitmaps);
+            }
+
+        private:
+            global_parameters m_params;
+            uint64_t m_num_docs;
+            uint64_t m_size;
+            uint64_t m_budget;
+            typename BaseIndex::builder m_base_builder;
+            std::vector<std::pair<uint64_t, uint64_t>> m_candidates; // (n, id)
+        };
+
+        size_t size() const
+        {
+            return m_size;
+        }
+
+        uint64_t num_docs() const
+        {
+            return m_num_docs;
+        }
+
+        uint64_t num_bitmaps() const
+        {
+            return m_num_bitmaps;
+        }
+
+        BaseIndex const& base() const
+        {
+            return m_base;
+        }
+
+        BaseIndex& base()
+        {
+            return m_base;
+        }
+
+        typedef typename BaseIndex::document_enumerator base_enumerator;
+
+        class document_enumerator {
+        public:
+            void reset()
+            {
+                m_base_enum.reset();
+            }
+
+            void DS2I_ALWAYSINLINE next()
+            {
+                m_base_enum.next();
+            }
+
+            void DS2I_ALWAYSINLINE next_geq(uint64_t lower_bound)
+            {
+                m_base_enum.next_geq(lower_bound);
+            }
+
+            void DS2I_ALWAYSINLINE move(uint64_t position)
+            {
+                m_base_enum.move(position);
+            }
+
+            uint64_t docid() const
+            {
+                return m_base_enum.docid();
+            }
+
+            uint64_t DS2I_ALWAYSINLINE freq()
+            {
+                return m_base_enum.freq();
+            }
+
+            uint64_t position() const
+            {
+                return m_base_enum.position();
+            }
+
+            uint64_t size() const
+            {
+                return m_base_enum.size();
+            }
+
+            bool has_bitmap() const
+            {
+                return m_bitmap != nullptr;
+            }
+
+            // Whether the list contains docid, regardless of the current
+            // position; only for lists with a bitmap
+            bool DS2I_ALWAYSINLINE contains(uint64_t docid) const
+            {
+                assert(has_bitmap());
+                return (m_bitmap[docid / 64] >> (docid % 64)) & 1;
+            }
+
+            // The bitmap words, ceil(num_docs / 64) of them
+            uint64_t const* bitmap() const
+            {
+                return m_bitmap;
+            }
+
+        private:
+            friend class bitmap_lists_index;
+
+            document_enumerator(base_enumerator const& e, uint64_t const* bitmap)
+                : m_base_enum(e)
+                , m_bitmap(bitmap)
+            {}
+
+            base_enumerator m_base_enum;
+            uint64_t const* m_bitmap;
+        };
+
+        document_enumerator operator[](size_t i) const
+        {
+            assert(i < size());
+            uint64_t const* bitmap = nullptr;
+            if (m_num_bitmaps) {
+                auto val = bitmap_ids_enum().next_geq(i);
+                if (val.second == i) {
+                    bitmap = m_bitmaps.data().data()
+                        + val.first * (bitmap_stride() / 64);
+                }
+            }
+            return document_enumerator(m_base[i], bitmap);
+        }
+
+        void warmup(size_t i) const
+        {
+            m_base.warmup(i);
+        }
+
+        void swap(bitmap_lists_index& other)
+        {
+            std::swap(m_params, other.m_params);
+            std::swap(m_size, other.m_size);
+            std::swap(m_num_docs, other.m_num_docs);
+            std::swap(m_num_bitmaps, other.m_num_bitmaps);
+            m_bitmap_ids.swap(other.m_bitmap_ids);
+            m_bitmaps.swap(other.m_bitmaps);
+            m_base.swap(other.m_base);
+        }
+
+        template <typename Visitor>
+        void map(Visitor& visit)
+        {
+            visit
+                (m_params, "m_params")
+                (m_size, "m_size")
+                (m_num_docs, "m_num_docs")
+                (m_num_bitmaps, "m_num_bitmaps")
+                (m_bitmap_ids, "m_bitmap_ids")
+                (m_bitmaps, "m_bitmaps")
+                (m_base, "m_base")
+                ;
+        }
+
+    private:
+        // the bitmaps are padded to whole words
+        uint64_t bitmap_stride() const
+        {
+            return (m_num_docs + 63) / 64 * 64;
+        }
+
+        compact_elias_fano::enumerator bitmap_ids_enum() const
+        {
+            return compact_elias_fano::enumerator(m_bitmap_ids, 0, m_size,
+                                                  m_num_bitmaps, m_params);
+        }
+
+        global_parameters m_params;
+        uint64_t m_size;
+        uint64_t m_num_docs;
+        uint64_t m_num_bitmaps;
+        succinct::bit_vector m_bitmap_ids;
+        succinct::bit_vector m_bitmaps;
+        BaseIndex m_base;
+    };
+}
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <memory>
+
 #include <succinct/bit_vector.hpp>
 
 #include "compact_elias_fano.hpp"
+#include "spilled_vector.hpp"
+#include "checkpoint.hpp"
 
 namespace ds2i {
 
@@ -12,36 +16,110 @@ namespace ds2i {
             : m_size(0)
         {}
 
+        // If DS2I_SPILL_DIR is set, the complete words of the bitvectors
+        // are periodically written to a file, and mapped back by build()
+        // into the collection, which keeps the mapping.
         class builder {
         public:
             builder(global_parameters const& params)
                 : m_params(params)
+                , m_spilled_bits(0)
             {
                 m_endpoints.push_back(0);
+
+                std::string spill = spill_filename();
+                if (!spill.empty()) {
+                    // the prefix field is the bit_vector length
+                    m_spilled_words.reset(new spilled_vector<uint64_t>(spill, 1));
+                }
             }
 
             void append(succinct::bit_vector_builder& bvb)
             {
                 m_bitvectors.append(bvb);
-                m_endpoints.push_back(m_bitvectors.size());
+                m_endpoints.push_back(m_spilled_bits + m_bitvectors.size());
+                if (m_spilled_words && m_bitvectors.size() >= spill_threshold) {
+                    spill();
+                }
+            }
+
+            // See block_freq_index::builder::attach; the last partial
+            // word is saved in the checkpoint state
+            void attach(checkpoint& ckpt, std::string const& name)
+            {
+                assert(m_endpoints.size() == 1);
+                if (ckpt.has(name + ".endpoints.size")) {
+                    ckpt.load_vector(name + ".endpoints", m_endpoints);
+                    m_spilled_bits = ckpt.get<uint64_t>(name + ".spilled_bits");
+                    uint64_t tail_bits = m_endpoints.back() - m_spilled_bits;
+                    assert(tail_bits < 64);
+                    succinct::bit_vector_builder tail;
+                    if (tail_bits) {
+                        tail.append_bits(ckpt.get<uint64_t>(name + ".tail"), tail_bits);
+                    }
+                    m_bitvectors.swap(tail);
+                }
+                m_spilled_words.reset(new spilled_vector<uint64_t>
+                                      (ckpt.data_filename(name + ".bits"), 1,
+                                       m_spilled_bits / 64));
+            }
+
+            void save(checkpoint& ckpt, std::string const& name)
+            {
+                assert(m_spilled_words);
+                spill();
+                m_spilled_words->flush();
+                ckpt.save_vector(name + ".endpoints", m_endpoints);
+                ckpt.set(name + ".spilled_bits", m_spilled_bits);
+                ckpt.set(name + ".tail", m_bitvectors.size()
+                         ? m_bitvectors.move_bits()[0] : uint64_t(0));
             }
 
             void build(bitvector_collection& sq)
             {
                 sq.m_size = m_endpoints.size() - 1;
-                succinct::bit_vector(&m_bitvectors).swap(sq.m_bitvectors);
+                uint64_t bits = m_spilled_bits + m_bitvectors.size();
+                if (m_spilled_words) {
+                    // the last partial word is padded with zeros
+                    spill();
+                    auto const& tail = m_bitvectors.move_bits();
+                    m_spilled_words->append(tail.data(), tail.size());
+                    sq.m_spill_mapping = m_spilled_words->map(sq.m_bitvectors, {bits});
+                } else {
+                    succinct::bit_vector(&m_bitvectors).swap(sq.m_bitvectors);
+                }
 
                 succinct::bit_vector_builder bvb;
                 compact_elias_fano::write(bvb, m_endpoints.begin(),
-                                          m_bitvectors.size(), sq.m_size,
+                                          bits, sq.m_size,
                                           m_params);
                 succinct::bit_vector(&bvb).swap(sq.m_endpoints);
             }
 
         private:
+            static const uint64_t spill_threshold = uint64_t(1) << 26;
+
+            // writes the complete words, keeping only the last partial one
+            void spill()
+            {
+                auto const& words = m_bitvectors.move_bits();
+                uint64_t complete_words = m_bitvectors.size() / 64;
+                uint64_t tail_bits = m_bitvectors.size() % 64;
+                m_spilled_words->append(words.data(), complete_words);
+                m_spilled_bits += 64 * complete_words;
+
+                succinct::bit_vector_builder tail;
+                if (tail_bits) {
+                    tail.append_bits(words[complete_words], tail_bits);
+                }
+                m_bitvectors.swap(tail);
+            }
+
             global_parameters m_params;
             std::vector<uint64_t> m_endpoints;
             succinct::bit_vector_builder m_bitvectors;
+            std::unique_ptr<spilled_vector<uint64_t>> m_spilled_words;
+            uint64_t m_spilled_bits;
         };
 
         size_t size() const
@@ -71,6 +149,7 @@ namespace ds2i {
             std::swap(m_size, other.m_size);
             m_endpoints.swap(other.m_endpoints);
             m_bitvectors.swap(other.m_bitvectors);
+            m_spill_mapping.swap(other.m_spill_mapping);
         }
 
         template <typename Visitor>
@@ -87,5 +166,6 @@ namespace ds2i {
         size_t m_size;
         succinct::bit_vector m_endpoints;
         succinct::bit_vector m_bitvectors;
+        spilled_vector<uint64_t>::mapping_type m_spill_mapping;
     };
 }
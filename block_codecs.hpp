@@ -159,22 +159,70 @@ struct optpfor_block {
         return *force_b;
       }
 
-      // this is mostly a cut&paste from FastPFor, but we stop the
-      // optimization early as the b to test becomes larger than maxb
+      // The candidates are the same as in FastPFor, but we stop as the b
+      // to test becomes larger than maxb. Instead of encoding the
+      // exceptions for every candidate, a histogram of the bit widths
+      // gives the exact size when there are no exceptions, and a lower
+      // bound otherwise: Simple16 packs at most 28 bits of slots per word,
+      // each exception position takes at least a 1-bit slot, and each
+      // exception value the smallest slot that fits its width. tryB is
+      // called only if the bound can beat the best size found so far.
+      static const uint32_t simple16_slot[29] = {
+          1, 1, 2, 3, 4, 5, 6, 7, 9, 9, 10, 14, 14, 14, 14,
+          28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28};
+      uint32_t width_count[33] = {0};
+      for (uint32_t i = 0; i < len; ++i) {
+        ++width_count[in[i] ? succinct::broadword::msb(in[i]) + 1 : 0];
+      }
+      uint32_t mb = 32;
+      while (mb && !width_count[mb])
+        --mb;
+
+      uint32_t begin = 0;
+      while (mb > 28 + possLogs[begin])
+        ++begin; // some schemes such as Simple16 don't code numbers greater than 28
+      uint32_t end = begin;
+      while (end < possLogs.size() && possLogs[end] <= mb)
+        ++end;
+
+      // candidates are visited by increasing lower bound, so we can stop
+      // as soon as the bound cannot beat the best size found so far. As
+      // in FastPFor, ties are broken towards larger b
+      struct candidate {
+        uint32_t b;
+        uint32_t lower_bound;
+        bool exact;
+      };
+      candidate candidates[33];
+      uint32_t n_candidates = 0;
+      for (uint32_t i = begin; i < end; ++i) {
+        const uint32_t cur_b = possLogs[i];
+        uint32_t exceptions = 0;
+        uint32_t exception_bits = 0;
+        for (uint32_t w = cur_b + 1; w <= mb; ++w) {
+          exceptions += width_count[w];
+          exception_bits += width_count[w] * simple16_slot[w - cur_b - 1];
+        }
+        candidates[n_candidates++] = candidate{
+            cur_b,
+            (len * cur_b + 31) / 32 + (exceptions + exception_bits + 27) / 28,
+            exceptions == 0};
+      }
+      std::sort(candidates, candidates + n_candidates,
+                [](candidate const &lhs, candidate const &rhs) {
+                  return lhs.lower_bound < rhs.lower_bound ||
+                         (lhs.lower_bound == rhs.lower_bound && lhs.b > rhs.b);
+                });
+
       uint32_t b = 0;
       uint32_t bsize = std::numeric_limits<uint32_t>::max();
-      const uint32_t mb = FastPFor::maxbits(in, in + len);
-      uint32_t i = 0;
-      while (mb > 28 + possLogs[i])
-        ++i; // some schemes such as Simple16 don't code numbers greater than 28
-
-      for (; i < possLogs.size(); i++) {
-        if (possLogs[i] > mb && possLogs[i] >= mb)
+      for (uint32_t i = 0; i < n_candidates; ++i) {
+        candidate const &c = candidates[i];
+        if (c.lower_bound > bsize || (c.lower_bound == bsize && c.b < b))
           break;
-        const uint32_t csize = tryB(possLogs[i], in, len);
-
-        if (csize <= bsize) {
-          b = possLogs[i];
+        const uint32_t csize = c.exact ? c.lower_bound : tryB(c.b, in, len);
+        if (csize < bsize || (csize == bsize && c.b > b)) {
+          b = c.b;
           bsize = csize;
         }
       }
@@ -1,10 +1,14 @@
 #pragma once
 
+#include <memory>
+
 #include <succinct/mappable_vector.hpp>
 #include <succinct/bit_vector.hpp>
 
 #include "compact_elias_fano.hpp"
 #include "block_posting_list.hpp"
+#include "spilled_vector.hpp"
+#include "checkpoint.hpp"
 
 namespace ds2i {
 
@@ -15,13 +19,26 @@ namespace ds2i {
             : m_size(0)
         {}
 
+        // If DS2I_SPILL_DIR is set, the lists are written to a file as
+        // they are added, and mapped back by build() into the index,
+        // which keeps the mapping.
         class builder {
         public:
             builder(uint64_t num_docs, global_parameters const& params)
+                : builder(num_docs, params, spill_filename())
+            {}
+
+            // Writes the lists to the file spill, unless it is empty
+            builder(uint64_t num_docs, global_parameters const& params,
+                    std::string const& spill)
                 : m_params(params)
             {
                 m_num_docs = num_docs;
                 m_endpoints.push_back(0);
+
+                if (!spill.empty()) {
+                    m_spilled_lists.reset(new spilled_vector<uint8_t>(spill));
+                }
             }
 
             template <typename DocsIterator, typename FreqsIterator>
@@ -31,7 +48,7 @@ namespace ds2i {
                 if (!n) throw std::invalid_argument("List must be nonempty");
                 block_posting_list<BlockCodec, Profile>::write(m_lists, n,
                                                                docs_begin, freqs_begin);
-                m_endpoints.push_back(m_lists.size());
+                commit_list();
             }
 
             template <typename BlockDataRange>
@@ -39,14 +56,36 @@ namespace ds2i {
             {
                 if (!n) throw std::invalid_argument("List must be nonempty");
                 block_posting_list<BlockCodec>::write_blocks(m_lists, n, blocks);
-                m_endpoints.push_back(m_lists.size());
+                commit_list();
             }
 
             template <typename BytesRange>
             void add_posting_list(BytesRange const& data)
             {
                 m_lists.insert(m_lists.end(), std::begin(data), std::end(data));
-                m_endpoints.push_back(m_lists.size());
+                commit_list();
+            }
+
+            // Makes the build resumable: the lists are written to a file
+            // of the checkpoint, and if the checkpoint has a saved state
+            // the builder restarts from it. Must be called before adding
+            // any list.
+            void attach(checkpoint& ckpt, std::string const& name)
+            {
+                assert(m_endpoints.size() == 1);
+                if (ckpt.has(name + ".endpoints.size")) {
+                    ckpt.load_vector(name + ".endpoints", m_endpoints);
+                }
+                m_spilled_lists.reset(new spilled_vector<uint8_t>
+                                      (ckpt.data_filename(name + ".lists"), 0,
+                                       m_endpoints.back()));
+            }
+
+            void save(checkpoint& ckpt, std::string const& name)
+            {
+                assert(m_spilled_lists);
+                m_spilled_lists->flush();
+                ckpt.save_vector(name + ".endpoints", m_endpoints);
             }
 
             void build(block_freq_index& sq)
@@ -54,7 +93,11 @@ namespace ds2i {
                 sq.m_params = m_params;
                 sq.m_size = m_endpoints.size() - 1;
                 sq.m_num_docs = m_num_docs;
-                sq.m_lists.steal(m_lists);
+                if (m_spilled_lists) {
+                    sq.m_spill_mapping = m_spilled_lists->map(sq.m_lists);
+                } else {
+                    sq.m_lists.steal(m_lists);
+                }
 
                 succinct::bit_vector_builder bvb;
                 compact_elias_fano::write(bvb, m_endpoints.begin(),
@@ -64,10 +107,22 @@ namespace ds2i {
             }
 
         private:
+            void commit_list()
+            {
+                if (m_spilled_lists) {
+                    m_spilled_lists->append(m_lists);
+                    m_lists.clear();
+                    m_endpoints.push_back(m_spilled_lists->size());
+                } else {
+                    m_endpoints.push_back(m_lists.size());
+                }
+            }
+
             global_parameters m_params;
             size_t m_num_docs;
             std::vector<uint64_t> m_endpoints;
             std::vector<uint8_t> m_lists;
+            std::unique_ptr<spilled_vector<uint8_t>> m_spilled_lists;
         };
 
         size_t size() const
@@ -119,6 +174,7 @@ namespace ds2i {
             std::swap(m_size, other.m_size);
             m_endpoints.swap(other.m_endpoints);
             m_lists.swap(other.m_lists);
+            m_spill_mapping.swap(other.m_spill_mapping);
         }
 
         template <typename Visitor>
@@ -139,5 +195,6 @@ namespace ds2i {
         size_t m_num_docs;
         succinct::bit_vector m_endpoints;
         succinct::mapper::mappable_vector<uint8_t> m_lists;
+        spilled_vector<uint8_t>::mapping_type m_spill_mapping;
     };
 }
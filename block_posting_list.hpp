@@ -313,8 +313,8 @@ namespace ds2i {
                 m_pos_in_block = 0;
                 m_cur_docid = m_docs_buf[0];
                 m_freqs_decoded = false;
-                if (Profile) {
-                    ++m_block_profile[2 * m_cur_block];
+                if (Profile && m_block_profile) {
+                    block_profiler::increment(m_block_profile[2 * m_cur_block]);
                 }
             }
 
@@ -325,8 +325,8 @@ namespace ds2i {
                 succinct::intrinsics::prefetch(next_block);
                 m_freqs_decoded = true;
 
-                if (Profile) {
-                    ++m_block_profile[2 * m_cur_block + 1];
+                if (Profile && m_block_profile) {
+                    block_profiler::increment(m_block_profile[2 * m_cur_block + 1]);
                 }
             }
 
@@ -1,40 +1,59 @@
 #pragma once
 
-#include <iostream>
 #include <atomic>
+#include <iostream>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "configuration.hpp"
 
 namespace ds2i {
 
+    // Counts the docs and freqs decodings of each block. Each thread
+    // increments its own shard of counters with relaxed loads and stores,
+    // so that the profiled query processing is not slowed down by
+    // synchronization; the shards are merged only in dump(), which can
+    // run while the queries are processed. A shard's mutex is taken by
+    // its thread only to add a list, and by dump() to read the shard.
+    // Only a fraction DS2I_PROFILE_SAMPLING of the opened lists is
+    // profiled, and the dumped counts are scaled accordingly.
     class block_profiler {
     public:
 
-        ~block_profiler()
-        {
-            std::lock_guard<std::mutex> lock(m_mutex);
-            for (auto const& it: m_block_freqs) {
-                delete [] it.second.second;
-            }
-        }
-
-        typedef std::atomic_uint_fast32_t counter_type;
+        typedef std::atomic<uint32_t> counter_type;
 
         static block_profiler& get() {
             static block_profiler instance;
             return instance;
         }
 
+        // Returns the 2 * blocks counters of the list in the calling
+        // thread's shard, or nullptr if this list opening is not sampled
         static counter_type* open_list(uint32_t term_id, uint32_t blocks)
         {
-            block_profiler& instance = get();
-            std::lock_guard<std::mutex> lock(instance.m_mutex);
-            auto& v = instance.m_block_freqs[term_id];
-            if (v.second == nullptr) {
-                v.first = 2 * blocks;
-                v.second = new counter_type[v.first];
-                std::fill(v.second, v.second + v.first, 0);
+            shard& s = thread_shard();
+            if (!s.sample()) return nullptr;
+
+            // only this thread modifies the shard, so the lookup needs
+            // no lock
+            auto it = s.block_freqs.find(term_id);
+            if (it == s.block_freqs.end()) {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                it = s.block_freqs.emplace(term_id,
+                                           std::vector<counter_type>(2 * blocks)).first;
             }
-            return v.second;
+            return it->second.data();
+        }
+
+        // Only the thread owning the counter can increment it
+        static void increment(counter_type& counter)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + 1,
+                          std::memory_order_relaxed);
         }
 
         static void dump(std::ostream& os)
@@ -42,11 +61,24 @@ namespace ds2i {
             block_profiler& instance = get();
             std::lock_guard<std::mutex> lock(instance.m_mutex);
 
-            for (auto const& it: instance.m_block_freqs) {
+            std::map<uint32_t, std::vector<uint64_t>> block_freqs;
+            for (auto const& s: instance.m_shards) {
+                std::lock_guard<std::mutex> shard_lock(s->mutex);
+                for (auto const& it: s->block_freqs) {
+                    auto& v = block_freqs[it.first];
+                    v.resize(it.second.size());
+                    for (size_t i = 0; i < it.second.size(); ++i) {
+                        v[i] += it.second[i].load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            double scale = 1 / instance.m_sampling;
+            for (auto const& it: block_freqs) {
                 os << it.first;
 
-                for (size_t i = 0; i < it.second.first; ++i) {
-                    os << '\t' << it.second.second[i];
+                for (auto freq: it.second) {
+                    os << '\t' << uint64_t(freq * scale + 0.5);
                 }
 
                 os << '\n';
@@ -54,10 +86,54 @@ namespace ds2i {
         }
 
     private:
-        block_profiler() {}
+        struct shard {
+            shard(double sampling, uint64_t seed)
+                : threshold(sampling >= 1 ? uint64_t(-1) : uint64_t(sampling * double(uint64_t(-1))))
+                , state(seed)
+            {}
+
+            bool sample()
+            {
+                if (threshold == uint64_t(-1)) return true;
+                // xorshift64, cheaper than a std:: engine on this path
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                return state < threshold;
+            }
+
+            std::unordered_map<uint32_t, std::vector<counter_type>> block_freqs;
+            std::mutex mutex;
+            uint64_t threshold;
+            uint64_t state;
+        };
+
+        block_profiler()
+            : m_sampling(configuration::get().profile_sampling)
+        {
+            if (m_sampling <= 0 || m_sampling > 1) {
+                throw std::invalid_argument("DS2I_PROFILE_SAMPLING must be in (0, 1]");
+            }
+        }
+
+        // The shards are owned by the profiler, so that they outlive the
+        // threads that filled them
+        static shard& thread_shard()
+        {
+            thread_local shard* s = nullptr;
+            if (!s) {
+                block_profiler& instance = get();
+                std::lock_guard<std::mutex> lock(instance.m_mutex);
+                instance.m_shards.emplace_back(
+                    new shard(instance.m_sampling,
+                              0x9E3779B97F4A7C15ULL * (instance.m_shards.size() + 1)));
+                s = instance.m_shards.back().get();
+            }
+            return *s;
+        }
 
-        // XXX can't do vector of atomics ARGHH
-        std::map<uint32_t, std::pair<size_t, counter_type*>> m_block_freqs;
+        double m_sampling;
+        std::vector<std::unique_ptr<shard>> m_shards;
         std::mutex m_mutex;
     };
 
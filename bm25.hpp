@@ -24,4 +24,26 @@ namespace ds2i {
         }
     };
 
+    // BM25F: the frequencies of the term in the fields of the document,
+    // each multiplied by the field weight and normalized by the field
+    // length, are summed into a single pseudo-frequency before saturation
+    struct bm25f {
+        static constexpr float k1 = bm25::k1;
+
+        static float field_norm(float weight, float b, float norm_len)
+        {
+            return weight / (1.0f - b + b * norm_len);
+        }
+
+        static float doc_term_weight(float pseudo_freq)
+        {
+            return pseudo_freq / (pseudo_freq + k1);
+        }
+
+        static float query_term_weight(uint64_t freq, uint64_t df, uint64_t num_docs)
+        {
+            return bm25::query_term_weight(freq, df, num_docs);
+        }
+    };
+
 }
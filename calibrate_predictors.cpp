@@ -0,0 +1,143 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <random>
+
+#include <boost/lexical_cast.hpp>
+
+#include "succinct/mapper.hpp"
+#include "configuration.hpp"
+#include "index_types.hpp"
+#include "util.hpp"
+#include "dec_time_profiling.hpp"
+
+namespace ds2i {
+
+    template <typename IndexType>
+    void calibrate_predictors(const char* index_filename,
+                              double p,
+                              const char* predictors_filename,
+                              double lambda)
+    {
+        using namespace time_prediction;
+
+        IndexType index;
+        logger() << "Loading index from " << index_filename << std::endl;
+        boost::iostreams::mapped_file_source m(index_filename);
+        succinct::mapper::map(index, m);
+
+        // the decoding times are measured in this thread only, so that
+        // they are not disturbed by the other threads
+        std::vector<std::vector<training_sample>> samples(mixed_block::block_types);
+        double tick = get_time_usecs();
+        profile_sampled_blocks(index, p, [&](uint8_t type, double time,
+                                             feature_vector const& fv) {
+                samples[type].push_back(training_sample { float(time), fv });
+            });
+        double profiling_secs = (get_time_usecs() - tick) / 1000000;
+        logger() << "Blocks profiled in " << profiling_secs << " seconds" << std::endl;
+
+        std::ofstream fout(predictors_filename);
+        std::mt19937 rng(1729);
+        size_t threads = configuration::get().worker_threads;
+
+        for (size_t t = 0; t < mixed_block::block_types; ++t) {
+            auto& type_samples = samples[t];
+            if (type_samples.empty()) {
+                logger() << "WARNING: no samples for block type " << t << std::endl;
+                continue;
+            }
+
+            // hold out 20% of the samples to evaluate the predictor
+            std::shuffle(type_samples.begin(), type_samples.end(), rng);
+            size_t split_point = std::max(size_t(1), type_samples.size() * 8 / 10);
+            std::vector<training_sample> training(type_samples.begin(),
+                                                  type_samples.begin() + split_point);
+            std::vector<training_sample> test(type_samples.begin() + split_point,
+                                              type_samples.end());
+            if (test.empty()) {
+                test = training;
+            }
+
+            std::vector<float> times;
+            for (auto const& s: training) {
+                times.push_back(s.time);
+            }
+            std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+            float median = times[times.size() / 2];
+
+            tick = get_time_usecs();
+            predictor pred = train_predictor(training, lambda, threads);
+            double training_secs = (get_time_usecs() - tick) / 1000000;
+
+            double constant_error = 0;
+            double linear_error = 0;
+            for (auto const& s: test) {
+                constant_error += std::abs(s.time - median);
+                linear_error += std::abs(s.time - pred(s.features));
+            }
+            constant_error /= test.size();
+            linear_error /= test.size();
+
+            logger() << "Block type " << t << ": " << type_samples.size()
+                     << " samples, median time " << median
+                     << ", error for constant predictor " << constant_error
+                     << ", error for linear predictor " << linear_error
+                     << std::endl;
+
+            stats_line()
+                ("type", t)
+                ("samples", type_samples.size())
+                ("median_time", median)
+                ("constant_error", constant_error)
+                ("linear_error", linear_error)
+                ("training_time", training_secs)
+                ;
+
+            // same format as dec_time_regression.py, read by load_predictors
+            fout << "type\t" << t << "\tbias\t" << pred.bias();
+            for (size_t i = 0; i < num_features; ++i) {
+                feature_type ft = (feature_type)i;
+                if (is_training_feature(ft)) {
+                    fout << "\t" << feature_name(ft) << "\t" << pred[ft];
+                }
+            }
+            fout << std::endl;
+        }
+    }
+}
+
+int main(int argc, const char** argv)
+{
+    using namespace ds2i;
+
+    if (argc < 5) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <index type> <index filename> <sample fraction> <predictors filename> [<lambda>]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string type = argv[1];
+    const char* index_filename = argv[2];
+    double p = boost::lexical_cast<double>(argv[3]);
+    const char* predictors_filename = argv[4];
+    double lambda = 0.01;
+    if (argc > 5) {
+        lambda = boost::lexical_cast<double>(argv[5]);
+    }
+
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                   \
+        } else if (type == BOOST_PP_STRINGIZE(T)) {             \
+            calibrate_predictors<BOOST_PP_CAT(T, _index)>       \
+                (index_filename, p, predictors_filename, lambda); \
+            /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_BLOCK_INDEX_TYPES);
+#undef LOOP_BODY
+    } else {
+        logger() << "ERROR: Unknown type " << type << std::endl;
+    }
+
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <boost/lexical_cast.hpp>
+
+#include "configuration.hpp"
+#include "util.hpp"
+
+namespace ds2i {
+
+    // The state of a long build, saved in the directory
+    // DS2I_CHECKPOINT_DIR so that an interrupted build can be resumed
+    // from the last commit() instead of from scratch. The state is made
+    // of named scalar values, saved in a text file replaced atomically at
+    // each commit, and of append-only vectors (for example the endpoints
+    // of an index builder), of which each commit writes only the new
+    // values. The encoded data of the builders goes to resumable
+    // spilled_vector files in the same directory (see data_filename()).
+    //
+    // Only the values committed are trusted when resuming: the data
+    // written after the last commit is truncated away. All the files are
+    // synced to disk before the state is replaced, so that the state
+    // never refers to data lost in a crash of the machine.
+    class checkpoint {
+    public:
+        checkpoint(std::string const& dir)
+            : m_dir(dir)
+            , m_resumed(false)
+            , m_last_commit(get_time_usecs())
+        {
+            std::ifstream fin(state_filename().c_str());
+            if (!fin) return;
+
+            std::string key, value;
+            while (fin >> key >> value) {
+                m_values[key] = value;
+            }
+            if (!m_values.count("complete")) {
+                throw std::runtime_error("Corrupted checkpoint in " + dir);
+            }
+            m_values.erase("complete");
+            m_resumed = true;
+        }
+
+        // True if the state of a previous build was found
+        bool resumed() const
+        {
+            return m_resumed;
+        }
+
+        std::string filename(std::string const& name) const
+        {
+            return m_dir + "/" + name;
+        }
+
+        // The file name for a data file, which is removed together with
+        // the checkpoint
+        std::string data_filename(std::string const& name)
+        {
+            m_data_files.push_back(filename(name));
+            return m_data_files.back();
+        }
+
+        bool has(std::string const& key) const
+        {
+            return m_values.count(key);
+        }
+
+        template <typename T>
+        void set(std::string const& key, T const& value)
+        {
+            m_values[key] = boost::lexical_cast<std::string>(value);
+        }
+
+        template <typename T>
+        T get(std::string const& key) const
+        {
+            auto it = m_values.find(key);
+            if (it == m_values.end()) {
+                throw std::runtime_error("Missing value " + key + " in checkpoint "
+                                         + m_dir);
+            }
+            return boost::lexical_cast<T>(it->second);
+        }
+
+        // Appends to the file of the vector the values added since the
+        // last save; v must extend the vector saved before. T must be a
+        // POD type.
+        template <typename T>
+        void save_vector(std::string const& name, std::vector<T> const& v)
+        {
+            uint64_t saved = has(name + ".size") ? get<uint64_t>(name + ".size") : 0;
+            if (v.size() < saved) {
+                throw std::logic_error("Vector " + name + " shrunk since the last save");
+            }
+            std::string fname = filename(name);
+            truncate_file(fname, saved * sizeof(T));
+            std::ofstream fout(fname.c_str(), std::ios::binary | std::ios::app);
+            fout.write(reinterpret_cast<const char*>(v.data() + saved),
+                       (v.size() - saved) * sizeof(T));
+            fout.close();
+            if (!fout) {
+                throw std::runtime_error("Error writing checkpoint file " + fname);
+            }
+            sync_file(fname);
+            set(name + ".size", v.size());
+        }
+
+        template <typename T>
+        void load_vector(std::string const& name, std::vector<T>& v) const
+        {
+            uint64_t size = get<uint64_t>(name + ".size");
+            std::string fname = filename(name);
+            std::ifstream fin(fname.c_str(), std::ios::binary);
+            v.resize(size);
+            fin.read(reinterpret_cast<char*>(v.data()), size * sizeof(T));
+            if (!fin) {
+                throw std::runtime_error("Truncated checkpoint file " + fname);
+            }
+        }
+
+        // True if DS2I_CHECKPOINT_INTERVAL seconds have passed since the
+        // last commit
+        bool due() const
+        {
+            return get_time_usecs() - m_last_commit
+                >= configuration::get().checkpoint_interval * 1000000;
+        }
+
+        // Saves the values; the vectors and the data files must be
+        // flushed before
+        void commit()
+        {
+            std::string fname = state_filename();
+            std::string tmp_fname = fname + ".tmp";
+            {
+                std::ofstream fout(tmp_fname.c_str());
+                for (auto const& kv: m_values) {
+                    fout << kv.first << " " << kv.second << "\n";
+                }
+                fout << "complete 1\n";
+                fout.close();
+                if (!fout) {
+                    throw std::runtime_error("Error writing checkpoint file " + tmp_fname);
+                }
+            }
+            sync_file(tmp_fname);
+            if (std::rename(tmp_fname.c_str(), fname.c_str())) {
+                throw std::runtime_error("Cannot replace checkpoint file " + fname);
+            }
+            // makes the rename durable
+            sync_file(m_dir);
+            m_last_commit = get_time_usecs();
+        }
+
+        // Removes the state and the data files once the build is
+        // complete
+        void remove()
+        {
+            for (auto const& fname: m_data_files) {
+                std::remove(fname.c_str());
+            }
+            m_data_files.clear();
+            for (auto const& kv: m_values) {
+                std::string const& key = kv.first;
+                std::string suffix = ".size";
+                if (key.size() > suffix.size() &&
+                    key.compare(key.size() - suffix.size(), suffix.size(), suffix) == 0) {
+                    std::remove(filename(key.substr(0, key.size() - suffix.size())).c_str());
+                }
+            }
+            std::remove(state_filename().c_str());
+            m_values.clear();
+            m_resumed = false;
+        }
+
+        static void truncate_file(std::string const& fname, uint64_t size)
+        {
+            if (::truncate(fname.c_str(), off_t(size)) && size) {
+                throw std::runtime_error("Cannot truncate checkpoint file " + fname);
+            }
+        }
+
+    private:
+        std::string state_filename() const
+        {
+            return filename("state");
+        }
+
+        std::string m_dir;
+        bool m_resumed;
+        double m_last_commit;
+        std::map<std::string, std::string> m_values;
+        std::vector<std::string> m_data_files;
+    };
+}
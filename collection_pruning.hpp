@@ -0,0 +1,237 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "binary_collection.hpp"
+#include "binary_freq_collection.hpp"
+#include "util.hpp"
+
+namespace ds2i {
+
+    // Static pruning of a binary_freq_collection: the postings are ranked
+    // by their impact, that is their score in a single-term query, and
+    // the low-impact ones are dropped, so that the pruned collection can
+    // be indexed with any index type and served as a smaller first tier.
+    // The methods are
+    //
+    // - term: term-centric (Carmel et al.), keeps the postings of each
+    //   list with impact at least param times the k-th highest impact of
+    //   the list;
+    //
+    // - document: document-centric (Buttcher and Clarke), keeps for each
+    //   document the fraction param of its postings with the highest
+    //   impact;
+    //
+    // - topk: keeps the param postings of each list with the highest
+    //   impact, that is the top-k of the single-term queries.
+    //
+    // The ties at the threshold are all kept, and so is the posting with
+    // the highest impact of each list, so that no list becomes empty and
+    // the term ids are preserved.
+    struct pruning_params {
+        pruning_params()
+            : method("term")
+            , param(0)
+            , k(10)
+        {}
+
+        std::string method;
+        double param;
+        uint64_t k;
+    };
+
+    struct pruning_stats {
+        pruning_stats()
+            : lists(0)
+            , postings(0)
+            , kept_postings(0)
+        {}
+
+        uint64_t lists;
+        uint64_t postings;
+        uint64_t kept_postings;
+    };
+
+    template <typename WandData>
+    class collection_pruner {
+    public:
+        typedef typename WandData::scorer_type scorer_type;
+
+        collection_pruner(binary_freq_collection const& coll,
+                          WandData const& wdata, pruning_params const& params)
+            : m_coll(coll)
+            , m_wdata(wdata)
+            , m_params(params)
+        {
+            if (params.method == "term") {
+                if (params.param < 0 || !params.k) {
+                    throw std::invalid_argument("Invalid term-centric parameters");
+                }
+            } else if (params.method == "document") {
+                if (!(params.param > 0 && params.param <= 1)) {
+                    throw std::invalid_argument("The fraction must be in (0, 1]");
+                }
+                compute_doc_thresholds();
+            } else if (params.method == "topk") {
+                if (params.param < 1) {
+                    throw std::invalid_argument("At least one posting must be kept");
+                }
+            } else {
+                throw std::invalid_argument("Unknown pruning method " + params.method);
+            }
+        }
+
+        // Writes the positions of the postings of seq to keep, in
+        // increasing order
+        void kept_positions(binary_freq_collection::sequence const& seq,
+                            std::vector<uint64_t>& positions)
+        {
+            positions.clear();
+            impacts(seq, m_impacts);
+            uint64_t n = m_impacts.size();
+            size_t best = std::max_element(m_impacts.begin(), m_impacts.end())
+                - m_impacts.begin();
+
+            float list_threshold = 0;
+            if (m_params.method == "term") {
+                list_threshold = float(m_params.param * kth_impact(m_params.k));
+            } else if (m_params.method == "topk") {
+                list_threshold = kth_impact(uint64_t(m_params.param));
+            }
+
+            for (uint64_t i = 0; i < n; ++i) {
+                float threshold = list_threshold;
+                if (m_params.method == "document") {
+                    threshold = m_doc_thresholds[*(seq.docs.begin() + i)];
+                }
+                if (m_impacts[i] >= threshold || i == best) {
+                    positions.push_back(i);
+                }
+            }
+        }
+
+        // Writes the pruned collection to output_basename.docs and
+        // output_basename.freqs
+        pruning_stats write(std::string const& output_basename)
+        {
+            std::ofstream docs_out((output_basename + ".docs").c_str(),
+                                   std::ios::binary);
+            std::ofstream freqs_out((output_basename + ".freqs").c_str(),
+                                    std::ios::binary);
+            std::vector<binary_collection::posting_type> docs, freqs;
+            docs.push_back(binary_collection::posting_type(m_coll.num_docs()));
+            write_sequence(docs_out, docs);
+
+            pruning_stats stats;
+            std::vector<uint64_t> positions;
+            for (auto const& seq: m_coll) {
+                kept_positions(seq, positions);
+                docs.clear();
+                freqs.clear();
+                for (auto i: positions) {
+                    docs.push_back(*(seq.docs.begin() + i));
+                    freqs.push_back(*(seq.freqs.begin() + i));
+                }
+                write_sequence(docs_out, docs);
+                write_sequence(freqs_out, freqs);
+
+                stats.lists += 1;
+                stats.postings += seq.docs.size();
+                stats.kept_postings += positions.size();
+            }
+
+            if (!docs_out || !freqs_out) {
+                throw std::runtime_error("Error writing the pruned collection");
+            }
+            return stats;
+        }
+
+    private:
+        void impacts(binary_freq_collection::sequence const& seq,
+                     std::vector<float>& impacts) const
+        {
+            uint64_t n = seq.docs.size();
+            float q_weight = scorer_type::query_term_weight
+                (1, n, m_coll.num_docs());
+            impacts.resize(n);
+            for (uint64_t i = 0; i < n; ++i) {
+                uint64_t docid = *(seq.docs.begin() + i);
+                uint64_t freq = *(seq.freqs.begin() + i);
+                impacts[i] = q_weight * scorer_type::doc_term_weight
+                    (freq, m_wdata.norm_len(docid));
+            }
+        }
+
+        // The k-th highest impact of the current list, or 0 if the list is
+        // shorter than k
+        float kth_impact(uint64_t k)
+        {
+            if (k > m_impacts.size()) return 0;
+            m_sorted_impacts = m_impacts;
+            auto kth = m_sorted_impacts.begin() + (k - 1);
+            std::nth_element(m_sorted_impacts.begin(), kth, m_sorted_impacts.end(),
+                             std::greater<float>());
+            return *kth;
+        }
+
+        // For the document-centric method the impacts are gathered by
+        // document, to find the threshold of each document
+        void compute_doc_thresholds()
+        {
+            uint64_t num_docs = m_coll.num_docs();
+            std::vector<uint64_t> doc_begin(num_docs + 1);
+            for (auto const& seq: m_coll) {
+                for (auto docid: seq.docs) {
+                    doc_begin[docid + 1] += 1;
+                }
+            }
+            for (uint64_t d = 0; d < num_docs; ++d) {
+                doc_begin[d + 1] += doc_begin[d];
+            }
+
+            std::vector<float> doc_impacts(doc_begin.back());
+            std::vector<uint64_t> doc_pos(doc_begin.begin(), doc_begin.end() - 1);
+            for (auto const& seq: m_coll) {
+                impacts(seq, m_impacts);
+                for (size_t i = 0; i < m_impacts.size(); ++i) {
+                    uint64_t docid = *(seq.docs.begin() + i);
+                    doc_impacts[doc_pos[docid]++] = m_impacts[i];
+                }
+            }
+
+            m_doc_thresholds.assign(num_docs, 0);
+            for (uint64_t d = 0; d < num_docs; ++d) {
+                auto begin = doc_impacts.begin() + doc_begin[d];
+                auto end = doc_impacts.begin() + doc_begin[d + 1];
+                uint64_t n = end - begin;
+                if (!n) continue;
+                uint64_t keep = std::max<uint64_t>(1, uint64_t(std::ceil(n * m_params.param)));
+                auto kth = begin + (std::min(keep, n) - 1);
+                std::nth_element(begin, kth, end, std::greater<float>());
+                m_doc_thresholds[d] = *kth;
+            }
+        }
+
+        static void write_sequence(std::ofstream& os,
+                                   std::vector<binary_collection::posting_type> const& seq)
+        {
+            binary_collection::posting_type n = seq.size();
+            os.write(reinterpret_cast<const char*>(&n), sizeof(n));
+            os.write(reinterpret_cast<const char*>(seq.data()),
+                     seq.size() * sizeof(seq[0]));
+        }
+
+        binary_freq_collection const& m_coll;
+        WandData const& m_wdata;
+        pruning_params m_params;
+        std::vector<float> m_doc_thresholds;
+        std::vector<float> m_impacts;
+        std::vector<float> m_sorted_impacts;
+    };
+}
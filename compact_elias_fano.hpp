@@ -193,19 +193,27 @@ namespace ds2i {
 
                 if (DS2I_LIKELY(lower_bound > m_value
                               && high_diff <= linear_scan_threshold)) {
-                    // optimize small skips
-                    next_reader next_value(*this, m_position + 1);
+                    // optimize small skips: the elements in the buckets
+                    // before the one of lower_bound are skipped looking
+                    // only at the high bits, so that the lower bits are
+                    // decoded only from that bucket on
+                    succinct::bit_vector::unary_enumerator he = m_high_enumerator;
+                    uint64_t high_base = m_of.higher_bits_offset + 1;
                     uint64_t val;
-                    do {
+                    while (true) {
                         m_position += 1;
-                        if (DS2I_LIKELY(m_position < size())) {
-                            val = next_value();
-                        } else {
+                        if (DS2I_UNLIKELY(m_position == size())) {
                             val = m_of.universe;
                             break;
                         }
-                    } while (val < lower_bound);
+                        uint64_t high = he.next() - high_base - m_position;
+                        if (high >= high_lower_bound) {
+                            val = (high << m_of.lower_bits) | read_low();
+                            if (val >= lower_bound) break;
+                        }
+                    }
 
+                    m_high_enumerator = he;
                     m_value = val;
                     return value();
                 } else {
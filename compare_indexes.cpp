@@ -0,0 +1,353 @@
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <unordered_set>
+#include <cmath>
+
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+
+#include <boost/lexical_cast.hpp>
+
+#include <succinct/mapper.hpp>
+
+#include "index_types.hpp"
+#include "wand_data.hpp"
+#include "queries.hpp"
+#include "util.hpp"
+
+// Compares two indexes of the same collection, possibly of different
+// types: the queries are replayed on both, interleaving them query by
+// query (and alternating which index goes first) so that the noise of
+// the machine affects both in the same way. For each query type it
+// reports the mean latency delta with a 95% confidence interval, and it
+// checks that the two indexes return the same results.
+
+namespace {
+
+    // Runs one query operator on one index; the two indexes can have
+    // different types, so they are hidden behind this interface
+    class query_runner {
+    public:
+        virtual ~query_runner() {}
+
+        // returns the number of results
+        virtual uint64_t operator()(ds2i::term_id_vec const& terms) = 0;
+
+        // the scores of the top-k of the last query, empty for the
+        // unranked operators
+        virtual void scores(std::vector<float>& scores) const = 0;
+    };
+
+    template <typename QueryOperator>
+    void topk_scores(QueryOperator const& query_op, std::vector<float>& scores)
+    {
+        for (auto const& entry: query_op.topk()) {
+            scores.push_back(entry.first);
+        }
+    }
+
+    template <bool with_freqs>
+    void topk_scores(ds2i::and_query<with_freqs> const&, std::vector<float>&)
+    {}
+
+    template <bool with_freqs>
+    void topk_scores(ds2i::or_query<with_freqs> const&, std::vector<float>&)
+    {}
+
+    template <typename IndexType, typename QueryOperator>
+    class typed_query_runner : public query_runner {
+    public:
+        typed_query_runner(IndexType const& index, QueryOperator query_op)
+            : m_index(index)
+            , m_query_op(query_op)
+        {}
+
+        uint64_t operator()(ds2i::term_id_vec const& terms)
+        {
+            return m_query_op(m_index, terms);
+        }
+
+        void scores(std::vector<float>& scores) const
+        {
+            scores.clear();
+            topk_scores(m_query_op, scores);
+        }
+
+    private:
+        IndexType const& m_index;
+        QueryOperator m_query_op;
+    };
+
+    class index_runner {
+    public:
+        virtual ~index_runner() {}
+
+        virtual uint64_t size_in_bytes() const = 0;
+
+        // returns nullptr if the query type is not supported
+        virtual std::unique_ptr<query_runner>
+        make_query_runner(std::string const& query_type,
+                          ds2i::wand_data<> const* wdata, uint64_t k) const = 0;
+    };
+
+    template <typename IndexType>
+    class typed_index_runner : public index_runner {
+    public:
+        typed_index_runner(const char* index_filename,
+                           std::vector<ds2i::term_id_vec> const& queries)
+        {
+            using namespace ds2i;
+            logger() << "Loading index from " << index_filename << std::endl;
+            m_file.open(index_filename);
+            succinct::mapper::map(m_index, m_file);
+            m_size = succinct::mapper::size_of(m_index);
+
+            std::unordered_set<term_id_type> warmed_up;
+            for (auto const& q: queries) {
+                for (auto t: q) {
+                    if (!warmed_up.count(t)) {
+                        m_index.warmup(t);
+                        warmed_up.insert(t);
+                    }
+                }
+            }
+        }
+
+        uint64_t size_in_bytes() const
+        {
+            return m_size;
+        }
+
+        std::unique_ptr<query_runner>
+        make_query_runner(std::string const& t,
+                          ds2i::wand_data<> const* wdata, uint64_t k) const
+        {
+            using namespace ds2i;
+            query_runner* runner = nullptr;
+            if (t == "and") {
+                runner = make(and_query<false>());
+            } else if (t == "and_freq") {
+                runner = make(and_query<true>());
+            } else if (t == "or") {
+                runner = make(or_query<false>());
+            } else if (t == "or_freq") {
+                runner = make(or_query<true>());
+            } else if (t == "wand" && wdata) {
+                runner = make(wand_query(*wdata, k));
+            } else if (t == "ranked_or" && wdata) {
+                runner = make(ranked_or_query(*wdata, k));
+            } else if (t == "ranked_and" && wdata) {
+                runner = make(ranked_and_query(*wdata, k));
+            } else if (t == "maxscore" && wdata) {
+                runner = make(maxscore_query(*wdata, k));
+            }
+            return std::unique_ptr<query_runner>(runner);
+        }
+
+    private:
+        template <typename QueryOperator>
+        query_runner* make(QueryOperator query_op) const
+        {
+            return new typed_query_runner<IndexType, QueryOperator>(m_index, query_op);
+        }
+
+        IndexType m_index;
+        boost::iostreams::mapped_file_source m_file;
+        uint64_t m_size;
+    };
+
+    std::unique_ptr<index_runner>
+    load_index(std::string const& type, const char* index_filename,
+               std::vector<ds2i::term_id_vec> const& queries)
+    {
+        using namespace ds2i;
+        index_runner* runner = nullptr;
+        if (false) {
+#define LOOP_BODY(R, DATA, T)                                           \
+        } else if (type == BOOST_PP_STRINGIZE(T)) {                     \
+            runner = new typed_index_runner<BOOST_PP_CAT(T, _index)>    \
+                (index_filename, queries);                              \
+            /**/
+
+            BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_INDEX_TYPES);
+            BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_TWO_TIER_INDEX_TYPES);
+#undef LOOP_BODY
+        } else {
+            throw std::invalid_argument("Unknown type " + type);
+        }
+        return std::unique_ptr<index_runner>(runner);
+    }
+
+    // The scores can differ in the last bits when the two index types
+    // sum them in a different order (as the two-tier indexes do), so they
+    // are compared with a relative tolerance
+    bool same_scores(std::vector<float> const& scores_a,
+                     std::vector<float> const& scores_b)
+    {
+        static const float tolerance = 1e-5;
+        if (scores_a.size() != scores_b.size()) return false;
+        for (size_t i = 0; i < scores_a.size(); ++i) {
+            float a = scores_a[i], b = scores_b[i];
+            if (std::abs(a - b) > tolerance * std::max(std::abs(a), std::abs(b))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void compare(index_runner const& index_a, index_runner const& index_b,
+                 ds2i::wand_data<> const* wdata,
+                 std::vector<ds2i::term_id_vec> const& queries,
+                 std::string const& query_type, uint64_t k, size_t runs)
+    {
+        using namespace ds2i;
+
+        auto query_a = index_a.make_query_runner(query_type, wdata, k);
+        auto query_b = index_b.make_query_runner(query_type, wdata, k);
+        if (!query_a || !query_b) {
+            logger() << "Unsupported query type: " << query_type << std::endl;
+            return;
+        }
+
+        // the first run is not timed, and checks the results
+        size_t mismatches = 0;
+        std::vector<float> scores_a, scores_b;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            uint64_t results_a = (*query_a)(queries[i]);
+            uint64_t results_b = (*query_b)(queries[i]);
+            query_a->scores(scores_a);
+            query_b->scores(scores_b);
+            // ties can be broken differently, so only the scores are compared
+            if (results_a != results_b || !same_scores(scores_a, scores_b)) {
+                if (!mismatches) {
+                    logger() << "Results differ at query " << i << ": "
+                             << results_a << " != " << results_b << std::endl;
+                }
+                mismatches += 1;
+            }
+        }
+
+        std::vector<double> times_a(queries.size()), times_b(queries.size());
+        for (size_t run = 0; run < runs; ++run) {
+            for (size_t i = 0; i < queries.size(); ++i) {
+                bool a_first = (i + run) % 2 == 0;
+                for (size_t j = 0; j < 2; ++j) {
+                    bool is_a = (j == 0) == a_first;
+                    auto tick = get_time_usecs();
+                    uint64_t result = is_a
+                        ? (*query_a)(queries[i])
+                        : (*query_b)(queries[i]);
+                    do_not_optimize_away(result);
+                    double elapsed = double(get_time_usecs() - tick);
+                    (is_a ? times_a : times_b)[i] += elapsed / runs;
+                }
+            }
+        }
+
+        // the deltas are paired by query, which cancels out the
+        // variance among the queries
+        size_t n = queries.size();
+        double avg_a = std::accumulate(times_a.begin(), times_a.end(), double()) / n;
+        double avg_b = std::accumulate(times_b.begin(), times_b.end(), double()) / n;
+        double delta = avg_b - avg_a;
+        double sq_sum = 0;
+        for (size_t i = 0; i < n; ++i) {
+            double d = times_b[i] - times_a[i] - delta;
+            sq_sum += d * d;
+        }
+        double stddev = n > 1 ? std::sqrt(sq_sum / (n - 1)) : 0;
+        double ci95 = 1.96 * stddev / std::sqrt(double(n));
+        double rel_delta = avg_a ? 100 * delta / avg_a : 0;
+        double rel_ci95 = avg_a ? 100 * ci95 / avg_a : 0;
+
+        logger() << "---- " << query_type << std::endl;
+        logger() << "Mean A: " << avg_a << " B: " << avg_b << std::endl;
+        logger() << "Delta: " << delta << " +- " << ci95
+                 << " (" << rel_delta << "% +- " << rel_ci95 << "%)" << std::endl;
+        if (mismatches) {
+            logger() << "WARNING: results differ on " << mismatches
+                     << " queries" << std::endl;
+        }
+
+        stats_line()
+            ("query", query_type)
+            ("k", k)
+            ("avg_a", avg_a)
+            ("avg_b", avg_b)
+            ("delta", delta)
+            ("ci95", ci95)
+            ("rel_delta", rel_delta)
+            ("rel_ci95", rel_ci95)
+            ("mismatches", mismatches)
+            ;
+    }
+}
+
+int main(int argc, const char** argv)
+{
+    using namespace ds2i;
+
+    if (argc < 6) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <type A> <index A> <type B> <index B> <query types>"
+                  << " [<wand data>] [<k>] < queries"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string type_a = argv[1];
+    const char* index_filename_a = argv[2];
+    std::string type_b = argv[3];
+    const char* index_filename_b = argv[4];
+    std::string query_type = argv[5];
+    const char* wand_data_filename = nullptr;
+    if (argc > 6) {
+        wand_data_filename = argv[6];
+    }
+    uint64_t k = 10;
+    if (argc > 7) {
+        k = boost::lexical_cast<uint64_t>(argv[7]);
+    }
+
+    std::vector<term_id_vec> queries;
+    term_id_vec q;
+    while (read_query(q)) queries.push_back(q);
+    if (queries.empty()) {
+        logger() << "No queries" << std::endl;
+        return 1;
+    }
+
+    auto index_a = load_index(type_a, index_filename_a, queries);
+    auto index_b = load_index(type_b, index_filename_b, queries);
+
+    wand_data<> wdata;
+    boost::iostreams::mapped_file_source md;
+    if (wand_data_filename) {
+        md.open(wand_data_filename);
+        succinct::mapper::map(wdata, md, succinct::mapper::map_flags::warmup);
+    }
+
+    uint64_t size_a = index_a->size_in_bytes();
+    uint64_t size_b = index_b->size_in_bytes();
+    double size_delta = 100 * (double(size_b) - double(size_a)) / size_a;
+    logger() << "A: " << type_a << " " << size_a << " bytes, B: "
+             << type_b << " " << size_b << " bytes ("
+             << size_delta << "%)" << std::endl;
+
+    stats_line()
+        ("type_a", type_a)
+        ("type_b", type_b)
+        ("size_a", size_a)
+        ("size_b", size_b)
+        ("size_delta", size_delta)
+        ;
+
+    std::vector<std::string> query_types;
+    boost::algorithm::split(query_types, query_type, boost::is_any_of(":"));
+    for (auto const& t: query_types) {
+        compare(*index_a, *index_b, wand_data_filename ? &wdata : nullptr,
+                queries, t, k, 5);
+    }
+}
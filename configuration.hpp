@@ -2,6 +2,8 @@
 
 #include <cstdlib>
 #include <cstdint>
+#include <limits>
+#include <string>
 #include <thread>
 #include <boost/lexical_cast.hpp>
 
@@ -23,6 +25,24 @@ namespace ds2i {
 
         bool heuristic_greedy;
 
+        double profile_sampling;
+
+        std::string spill_dir;
+
+        std::string checkpoint_dir;
+        double checkpoint_interval;
+
+        size_t heap_or_threshold;
+
+        size_t max_connections;
+
+        uint64_t bitmap_budget;
+
+        std::string static_scores;
+        double static_weight;
+
+        double threshold_factor;
+
     private:
         configuration()
         {
@@ -32,6 +52,17 @@ namespace ds2i {
             fillvar("DS2I_LOG_PART", log_partition_size, 7);
             fillvar("DS2I_THREADS", worker_threads, std::thread::hardware_concurrency());
             fillvar("DS2I_HEURISTIC_GREEDY", heuristic_greedy, false);
+            fillvar("DS2I_PROFILE_SAMPLING", profile_sampling, 1.0);
+            fillvar("DS2I_SPILL_DIR", spill_dir, "");
+            fillvar("DS2I_CHECKPOINT_DIR", checkpoint_dir, "");
+            fillvar("DS2I_CHECKPOINT_INTERVAL", checkpoint_interval, 600);
+            fillvar("DS2I_HEAP_OR_THRESHOLD", heap_or_threshold, 32);
+            fillvar("DS2I_MAX_CONNECTIONS", max_connections, 64);
+            fillvar("DS2I_BITMAP_BUDGET", bitmap_budget,
+                    std::numeric_limits<uint64_t>::max());
+            fillvar("DS2I_STATIC_SCORES", static_scores, "");
+            fillvar("DS2I_STATIC_WEIGHT", static_weight, 1.0);
+            fillvar("DS2I_THRESHOLD_FACTOR", threshold_factor, 1.0);
         }
 
         template <typename T, typename T2>
@@ -58,6 +58,28 @@ void dump_index_specific_stats(ds2i::opt_index const& coll,
         ;
 }
 
+template <typename BaseIndex, size_t MaxTinySize>
+void dump_index_specific_stats(ds2i::tiny_lists_index<BaseIndex, MaxTinySize> const& coll,
+                               std::string const& type)
+{
+    ds2i::stats_line()
+        ("type", type)
+        ("max_tiny_size", MaxTinySize)
+        ("tiny_lists", coll.num_tiny_lists())
+        ;
+}
+
+template <typename FirstIndex, typename SecondIndex>
+void dump_index_specific_stats(ds2i::hybrid_lists_index<FirstIndex, SecondIndex> const& coll,
+                               std::string const& type)
+{
+    ds2i::stats_line()
+        ("type", type)
+        ("length_threshold", uint64_t(coll.default_length_threshold))
+        ("second_lists", coll.num_second_lists())
+        ;
+}
+
 template <typename InputCollection, typename CollectionType>
 void create_collection(InputCollection const& input,
                        ds2i::global_parameters const& params,
@@ -72,13 +94,22 @@ void create_collection(InputCollection const& input,
 
     typename CollectionType::builder builder(input.num_docs(), params);
     progress_logger plog;
+    build_checkpointer<CollectionType> ckpt(seq_type, input.num_docs(), plog);
+    ckpt.attach(builder);
+    uint64_t lists = 0;
     for (auto const& plist: input) {
+        // skip the lists added before the checkpoint
+        if (lists++ < ckpt.resumed_lists()) continue;
+
         uint64_t freqs_sum = std::accumulate(plist.freqs.begin(),
                                              plist.freqs.end(), uint64_t(0));
 
         builder.add_posting_list(plist.docs.size(), plist.docs.begin(),
                                  plist.freqs.begin(), freqs_sum);
         plog.done_sequence(plist.docs.size());
+        if (ckpt.due()) {
+            ckpt.save(builder, lists);
+        }
     }
 
     plog.log();
@@ -105,6 +136,9 @@ void create_collection(InputCollection const& input,
             verify_collection<InputCollection, CollectionType>(input, output_filename);
         }
     }
+    // the checkpoint is kept until the index is written, since its data
+    // files are mapped into coll
+    ckpt.complete();
 }
 
 
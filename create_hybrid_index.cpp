@@ -0,0 +1,193 @@
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+
+#include <boost/lexical_cast.hpp>
+
+#include <succinct/mapper.hpp>
+
+#include "configuration.hpp"
+#include "index_types.hpp"
+#include "util.hpp"
+#include "queries.hpp"
+#include "verify_collection.hpp"
+#include "index_build_utils.hpp"
+
+using ds2i::logger;
+
+// Chooses the representation of each list of a hybrid_lists_index under a
+// space budget. All the lists start in the first (smaller)
+// representation; then they are moved to the second (faster) one by
+// decreasing ratio between benefit and additional space, as long as the
+// budget allows. The benefit of a list is estimated as the number of
+// postings scanned on the query log, that is its length times the number
+// of queries where it appears; without a query log every list counts as
+// accessed once, so the choice is driven by list length only.
+template <typename InputCollection, typename CollectionType>
+void create_hybrid_collection(InputCollection const& input,
+                              ds2i::global_parameters const& params,
+                              std::vector<uint64_t> const& accesses,
+                              uint64_t space_budget,
+                              const char* output_filename,
+                              bool check)
+{
+    using namespace ds2i;
+    typedef typename CollectionType::representation representation;
+
+    logger() << "Processing " << input.num_docs() << " documents" << std::endl;
+    double tick = get_time_usecs();
+
+    struct list_choice {
+        uint64_t list;
+        double benefit;
+        int64_t extra_bits;
+    };
+
+    std::vector<list_choice> choices;
+    uint64_t first_bits = 0;
+    {
+        progress_logger plog;
+        uint64_t l = 0;
+        for (auto const& plist: input) {
+            uint64_t n = plist.docs.size();
+            uint64_t freqs_sum = std::accumulate(plist.freqs.begin(),
+                                                 plist.freqs.end(), uint64_t(0));
+            uint64_t bits1 = posting_list_size<typename CollectionType::first_index_type>
+                ::bits(params, input.num_docs(), n, plist.docs.begin(),
+                       plist.freqs.begin(), freqs_sum);
+            uint64_t bits2 = posting_list_size<typename CollectionType::second_index_type>
+                ::bits(params, input.num_docs(), n, plist.docs.begin(),
+                       plist.freqs.begin(), freqs_sum);
+            first_bits += bits1;
+
+            uint64_t list_accesses = accesses.empty() ? 1
+                : (l < accesses.size() ? accesses[l] : 0);
+            choices.push_back(list_choice { l, double(list_accesses) * n,
+                                            int64_t(bits2) - int64_t(bits1) });
+            l += 1;
+            plog.done_sequence(n);
+        }
+        plog.log();
+    }
+
+    // lists that are not larger in the second representation are always
+    // moved, then the others by decreasing benefit per extra bit
+    std::sort(choices.begin(), choices.end(),
+              [](list_choice const& lhs, list_choice const& rhs) {
+                  if ((lhs.extra_bits <= 0) != (rhs.extra_bits <= 0)) {
+                      return lhs.extra_bits <= 0;
+                  }
+                  if (lhs.extra_bits <= 0) {
+                      return lhs.benefit > rhs.benefit;
+                  }
+                  return lhs.benefit * rhs.extra_bits > rhs.benefit * lhs.extra_bits;
+              });
+
+    std::vector<representation> reprs(choices.size(),
+                                      CollectionType::first_representation);
+    int64_t budget_bits = int64_t(8 * space_budget) - int64_t(first_bits);
+    if (budget_bits < 0) {
+        logger() << "WARNING: space budget is smaller than the first representation, "
+                 << first_bits / 8 << " bytes" << std::endl;
+    }
+    int64_t used_bits = 0;
+    uint64_t moved_postings = 0;
+    for (auto const& c: choices) {
+        if (c.extra_bits > 0 && (c.benefit == 0 || used_bits + c.extra_bits > budget_bits)) {
+            continue;
+        }
+        reprs[c.list] = CollectionType::second_representation;
+        used_bits += c.extra_bits;
+    }
+
+    typename CollectionType::builder builder(input.num_docs(), params);
+    progress_logger plog;
+    uint64_t l = 0;
+    for (auto const& plist: input) {
+        uint64_t freqs_sum = std::accumulate(plist.freqs.begin(),
+                                             plist.freqs.end(), uint64_t(0));
+
+        builder.add_posting_list(plist.docs.size(), plist.docs.begin(),
+                                 plist.freqs.begin(), freqs_sum, reprs[l]);
+        if (reprs[l] == CollectionType::second_representation) {
+            moved_postings += plist.docs.size();
+        }
+        plog.done_sequence(plist.docs.size());
+        l += 1;
+    }
+
+    plog.log();
+    CollectionType coll;
+    builder.build(coll);
+    double elapsed_secs = (get_time_usecs() - tick) / 1000000;
+    logger() << "Hybrid collection built in "
+             << elapsed_secs << " seconds" << std::endl;
+    logger() << coll.num_second_lists() << " lists, " << moved_postings
+             << " postings in the second representation" << std::endl;
+
+    stats_line()
+        ("type", "hybrid")
+        ("space_budget", space_budget)
+        ("construction_time", elapsed_secs)
+        ("second_lists", coll.num_second_lists())
+        ("second_postings", moved_postings)
+        ;
+
+    dump_stats(coll, "hybrid", plog.postings);
+
+    if (output_filename) {
+        succinct::mapper::freeze(coll, output_filename);
+        if (check) {
+            verify_collection<InputCollection, CollectionType>(input, output_filename);
+        }
+    }
+}
+
+int main(int argc, const char** argv) {
+
+    using namespace ds2i;
+
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <collection basename> <space budget in bytes> <output filename> [<queries filename>] [--check]"
+                  << std::endl;
+        return 1;
+    }
+
+    const char* input_basename = argv[1];
+    uint64_t space_budget = boost::lexical_cast<uint64_t>(argv[2]);
+    const char* output_filename = argv[3];
+
+    bool check = false;
+    std::vector<uint64_t> accesses;
+    for (int i = 4; i < argc; ++i) {
+        if (std::string(argv[i]) == "--check") {
+            check = true;
+            continue;
+        }
+
+        // count the queries where each term appears
+        std::ifstream fin(argv[i]);
+        term_id_vec q;
+        while (read_query(q, fin)) {
+            remove_duplicate_terms(q);
+            for (auto term: q) {
+                if (term >= accesses.size()) {
+                    accesses.resize(term + 1);
+                }
+                accesses[term] += 1;
+            }
+        }
+        logger() << "Read query log " << argv[i] << std::endl;
+    }
+
+    binary_freq_collection input(input_basename);
+    ds2i::global_parameters params;
+    params.log_partition_size = configuration::get().log_partition_size;
+
+    create_hybrid_collection<binary_freq_collection, hybrid_index>
+        (input, params, accesses, space_budget, output_filename, check);
+
+    return 0;
+}
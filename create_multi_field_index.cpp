@@ -0,0 +1,167 @@
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+
+#include <succinct/mapper.hpp>
+
+#include "configuration.hpp"
+#include "binary_multi_field_collection.hpp"
+#include "index_types.hpp"
+#include "util.hpp"
+#include "verify_collection.hpp"
+#include "index_build_utils.hpp"
+
+using ds2i::logger;
+
+template <typename InputCollection, typename CollectionType>
+void verify_fields(InputCollection const& input, const char* filename)
+{
+    CollectionType coll;
+    boost::iostreams::mapped_file_source m(filename);
+    succinct::mapper::map(coll, m);
+
+    logger() << "Checking the field frequencies..." << std::endl;
+    uint64_t num_fields = input.num_fields();
+    std::vector<uint64_t> freqs(num_fields);
+    size_t s = 0;
+    for (auto const& seq: input) {
+        auto e = coll[s];
+        auto fields_it = seq.fields.begin();
+        for (size_t i = 0; i < e.size(); ++i, e.next()) {
+            e.field_freqs(freqs.data());
+            for (uint64_t f = 0; f < num_fields; ++f, ++fields_it) {
+                if (freqs[f] != *fields_it) {
+                    logger() << "field " << f << " freq in sequence " << s
+                             << " differs at position " << i << "!" << std::endl;
+                    logger() << freqs[f] << " != " << *fields_it << std::endl;
+                    exit(1);
+                }
+            }
+        }
+        s += 1;
+    }
+    logger() << "Everything is OK!" << std::endl;
+}
+
+template <typename InputCollection, typename CollectionType>
+void create_multi_field_collection(InputCollection const& input,
+                                   ds2i::global_parameters const& params,
+                                   const char* output_filename, bool check,
+                                   std::string const& seq_type)
+{
+    using namespace ds2i;
+
+    uint64_t num_fields = input.num_fields();
+    logger() << "Processing " << input.num_docs() << " documents with "
+             << num_fields << " fields" << std::endl;
+    double tick = get_time_usecs();
+
+    typename CollectionType::builder builder(input.num_docs(), num_fields, params);
+    progress_logger plog;
+    for (auto const& plist: input) {
+        uint64_t n = plist.docs.size();
+        if (plist.fields.size() != n * num_fields) {
+            throw std::invalid_argument("Fields sequence " + std::to_string(plog.sequences)
+                                        + " has wrong length");
+        }
+        uint64_t freqs_sum = 0;
+        auto fields_it = plist.fields.begin();
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t freq = *(plist.freqs.begin() + i);
+            uint64_t fields_sum = std::accumulate(fields_it, fields_it + num_fields,
+                                                  uint64_t(0));
+            if (fields_sum != freq) {
+                throw std::invalid_argument("Field frequencies in sequence "
+                                            + std::to_string(plog.sequences)
+                                            + " do not sum to the frequency");
+            }
+            freqs_sum += freq;
+            fields_it += num_fields;
+        }
+
+        builder.add_posting_list(n, plist.docs.begin(), plist.freqs.begin(),
+                                 freqs_sum, plist.fields.begin());
+        plog.done_sequence(n);
+    }
+
+    plog.log();
+    CollectionType coll;
+    builder.build(coll);
+    double elapsed_secs = (get_time_usecs() - tick) / 1000000;
+    logger() << seq_type << " collection built in "
+             << elapsed_secs << " seconds" << std::endl;
+
+    uint64_t fields_size = 0;
+    auto size_tree = succinct::mapper::size_tree_of(coll);
+    for (auto const& node: size_tree->children) {
+        if (node->name == "m_fields_sequences") {
+            fields_size = node->size;
+        }
+    }
+    double bits_per_fields = fields_size * 8.0 / plog.postings;
+    logger() << "Field frequencies: " << fields_size << " bytes, "
+             << bits_per_fields << " bits per element" << std::endl;
+
+    stats_line()
+        ("type", seq_type)
+        ("num_fields", num_fields)
+        ("construction_time", elapsed_secs)
+        ("fields_size", fields_size)
+        ("bits_per_fields", bits_per_fields)
+        ;
+
+    dump_stats(coll, seq_type, plog.postings);
+
+    if (output_filename) {
+        succinct::mapper::freeze(coll, output_filename);
+        if (check) {
+            verify_collection<InputCollection, CollectionType>(input, output_filename);
+            verify_fields<InputCollection, CollectionType>(input, output_filename);
+        }
+    }
+}
+
+int main(int argc, const char** argv) {
+
+    using namespace ds2i;
+
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <index type> <collection basename> [<output filename>] [--check]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string type = argv[1];
+    const char* input_basename = argv[2];
+    const char* output_filename = nullptr;
+    if (argc > 3) {
+        output_filename = argv[3];
+    }
+
+    bool check = false;
+    if (argc > 4 && std::string(argv[4]) == "--check") {
+        check = true;
+    }
+
+    binary_multi_field_collection input(input_basename);
+    ds2i::global_parameters params;
+    params.log_partition_size = configuration::get().log_partition_size;
+
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                           \
+        } else if (type == BOOST_PP_STRINGIZE(T)) {                     \
+            create_multi_field_collection<binary_multi_field_collection, \
+                                          BOOST_PP_CAT(T, _index)>      \
+                (input, params, output_filename, check, type);          \
+            /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_MULTI_FIELD_INDEX_TYPES);
+#undef LOOP_BODY
+    } else {
+        logger() << "ERROR: Unknown type " << type << std::endl;
+    }
+
+    return 0;
+}
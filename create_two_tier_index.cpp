@@ -0,0 +1,161 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include <boost/lexical_cast.hpp>
+
+#include <succinct/mapper.hpp>
+
+#include "configuration.hpp"
+#include "index_types.hpp"
+#include "util.hpp"
+#include "wand_data.hpp"
+#include "verify_collection.hpp"
+#include "index_build_utils.hpp"
+
+using ds2i::logger;
+
+// Builds a two_tier_index: the lists with at least min_length postings
+// are split, and the fraction high_fraction of their postings with the
+// highest doc_term_weight goes in the high tier, unless the tiers would
+// not be traversed separately at query time (see two_tier_index). The weights are computed
+// with the document lengths of the wand data, which must be the one used
+// at query time.
+template <typename InputCollection, typename CollectionType>
+void create_two_tier_collection(InputCollection const& input,
+                                ds2i::global_parameters const& params,
+                                ds2i::wand_data<> const& wdata,
+                                uint64_t min_length, double high_fraction,
+                                const char* output_filename, bool check,
+                                std::string const& type)
+{
+    using namespace ds2i;
+    typedef wand_data<>::scorer_type scorer_type;
+
+    logger() << "Processing " << input.num_docs() << " documents" << std::endl;
+    double tick = get_time_usecs();
+
+    typename CollectionType::builder builder(input.num_docs(), params);
+    progress_logger plog;
+    uint64_t high_postings = 0;
+    std::vector<float> weights;
+    for (auto const& plist: input) {
+        uint64_t n = plist.docs.size();
+        uint64_t freqs_sum = std::accumulate(plist.freqs.begin(),
+                                             plist.freqs.end(), uint64_t(0));
+        if (n >= min_length) {
+            weights.resize(n);
+            for (uint64_t i = 0; i < n; ++i) {
+                weights[i] = scorer_type::doc_term_weight
+                    (*(plist.freqs.begin() + i),
+                     wdata.norm_len(*(plist.docs.begin() + i)));
+            }
+            uint64_t high_size = std::max<uint64_t>
+                (1, uint64_t(std::ceil(n * high_fraction)));
+            bool split = builder.add_posting_list(n, plist.docs.begin(),
+                                                  plist.freqs.begin(), freqs_sum,
+                                                  weights.begin(), high_size);
+            high_postings += split ? high_size : n;
+        } else {
+            builder.add_posting_list(n, plist.docs.begin(), plist.freqs.begin(),
+                                     freqs_sum);
+            high_postings += n;
+        }
+        plog.done_sequence(n);
+    }
+
+    plog.log();
+    CollectionType coll;
+    builder.build(coll);
+    double elapsed_secs = (get_time_usecs() - tick) / 1000000;
+    logger() << type << " collection built in "
+             << elapsed_secs << " seconds" << std::endl;
+    logger() << coll.num_split_lists() << " lists split, "
+             << plog.postings - high_postings
+             << " postings in the low tier" << std::endl;
+
+    stats_line()
+        ("type", type)
+        ("min_length", min_length)
+        ("high_fraction", high_fraction)
+        ("construction_time", elapsed_secs)
+        ("split_lists", coll.num_split_lists())
+        ("low_postings", plog.postings - high_postings)
+        ;
+
+    dump_stats(coll, type, plog.postings);
+
+    if (output_filename) {
+        succinct::mapper::freeze(coll, output_filename);
+        if (check) {
+            verify_collection<InputCollection, CollectionType>(input, output_filename);
+        }
+    }
+}
+
+int main(int argc, const char** argv) {
+
+    using namespace ds2i;
+
+    if (argc < 5) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <index type> <collection basename> <wand data> <output filename>"
+                  << " [<min length>] [<high fraction>] [--check]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string type = argv[1];
+    const char* input_basename = argv[2];
+    const char* wand_data_filename = argv[3];
+    const char* output_filename = argv[4];
+
+    uint64_t min_length = 1 << 12;
+    double high_fraction = 0.1;
+    bool check = false;
+    std::vector<const char*> args;
+    for (int i = 5; i < argc; ++i) {
+        if (std::string(argv[i]) == "--check") {
+            check = true;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    if (args.size() > 0) {
+        min_length = boost::lexical_cast<uint64_t>(args[0]);
+    }
+    if (args.size() > 1) {
+        high_fraction = boost::lexical_cast<double>(args[1]);
+    }
+    if (!(high_fraction > 0 && high_fraction < 1)) {
+        logger() << "ERROR: The high fraction must be in (0, 1)" << std::endl;
+        return 1;
+    }
+
+    binary_freq_collection input(input_basename);
+    wand_data<> wdata;
+    boost::iostreams::mapped_file_source md(wand_data_filename);
+    succinct::mapper::map(wdata, md, succinct::mapper::map_flags::warmup);
+
+    ds2i::global_parameters params;
+    params.log_partition_size = configuration::get().log_partition_size;
+
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                           \
+        } else if (type == BOOST_PP_STRINGIZE(T)) {                     \
+            create_two_tier_collection<binary_freq_collection,          \
+                                       BOOST_PP_CAT(T, _index)>         \
+                (input, params, wdata, min_length, high_fraction,       \
+                 output_filename, check, type);                         \
+            /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_TWO_TIER_INDEX_TYPES);
+#undef LOOP_BODY
+    } else {
+        logger() << "ERROR: Unknown type " << type << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -1,19 +1,36 @@
 #include <fstream>
 #include <iostream>
 
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/lexical_cast.hpp>
+
 #include "succinct/mapper.hpp"
 #include "binary_freq_collection.hpp"
+#include "binary_multi_field_collection.hpp"
 #include "binary_collection.hpp"
 #include "wand_data.hpp"
+#include "multi_field_wand_data.hpp"
 #include "util.hpp"
 
+std::vector<float> parse_field_params(std::string const& s)
+{
+    std::vector<std::string> tokens;
+    boost::algorithm::split(tokens, s, boost::is_any_of(":"));
+    std::vector<float> ret;
+    for (auto const& t: tokens) {
+        ret.push_back(boost::lexical_cast<float>(t));
+    }
+    return ret;
+}
+
 int main(int argc, const char** argv) {
 
     using namespace ds2i;
 
-    if (argc != 3) {
+    if (argc != 3 && argc != 5) {
         std::cerr << "Usage: " << argv[0]
-                  << " <collection basename> <output filename>"
+                  << " <collection basename> <output filename> [<field weights> <field b>]"
                   << std::endl;
         return 1;
     }
@@ -21,6 +38,33 @@ int main(int argc, const char** argv) {
     std::string input_basename = argv[1];
     const char* output_filename = argv[2];
 
+    if (argc == 5) {
+        // BM25F on a multi-field collection: weights and b are given for
+        // each field, separated by colons (for example 3:1:2 0.6:0.75:0.4)
+        std::vector<float> field_weights = parse_field_params(argv[3]);
+        std::vector<float> field_b = parse_field_params(argv[4]);
+
+        binary_collection field_sizes_coll((input_basename + ".field_sizes").c_str());
+        binary_multi_field_collection coll(input_basename.c_str());
+
+        std::vector<binary_collection::posting_type const*> field_lengths;
+        for (auto const& seq: field_sizes_coll) {
+            if (field_lengths.size() == coll.num_fields()) break;
+            if (seq.size() != coll.num_docs()) {
+                throw std::invalid_argument("Field sizes sequence has wrong length");
+            }
+            field_lengths.push_back(seq.begin());
+        }
+        if (field_lengths.size() != coll.num_fields()) {
+            throw std::invalid_argument("Missing field sizes");
+        }
+
+        multi_field_wand_data<> wdata(field_lengths, coll.num_docs(), coll,
+                                      field_weights, field_b);
+        succinct::mapper::freeze(wdata, output_filename);
+        return 0;
+    }
+
     binary_collection sizes_coll((input_basename + ".sizes").c_str());
     binary_freq_collection coll(input_basename.c_str());
 
@@ -1,8 +1,13 @@
 #pragma once
 
 #include <array>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <boost/preprocessor/seq/enum.hpp>
 #include <boost/preprocessor/seq/for_each.hpp>
@@ -142,6 +147,153 @@ namespace ds2i { namespace time_prediction {
         f[feature_type::max_b] = max_b;
     }
 
+    // features not used for training, as in dec_time_regression.py
+    bool is_training_feature(feature_type f)
+    {
+        return f != feature_type::n && f != feature_type::entropy;
+    }
+
+    struct training_sample {
+        float time;
+        feature_vector features;
+    };
+
+    // Fits a predictor with non-negative weights and bias, minimizing the
+    // Huber loss (with threshold eps) of the errors plus lambda *
+    // samples.size() times the L1 norm of the weights, as l1l1.py does.
+    // The loss is minimized by iteratively reweighted least squares, with
+    // weight 1 / max(|residual|, eps), and each weighted problem is solved
+    // by coordinate descent on its Gram matrix. Accumulating the Gram
+    // matrix is the only pass over the samples, so it is split among the
+    // threads. The weights with the lowest cost seen are returned.
+    predictor train_predictor(std::vector<training_sample> const& samples,
+                              double lambda, size_t threads)
+    {
+        static const size_t dims = num_features + 1; // bias is the last one
+        static const size_t max_iterations = 100;
+        static const size_t max_sweeps = 1000;
+        static const double eps = 0.1;
+
+        typedef std::array<double, dims> vec_type;
+        typedef std::array<vec_type, dims> mat_type;
+
+        predictor result;
+        if (samples.empty()) return result;
+        threads = std::max(threads, size_t(1));
+
+        auto get_x = [&](training_sample const& s, vec_type& x) {
+            for (size_t j = 0; j < num_features; ++j) {
+                feature_type ft = (feature_type)j;
+                x[j] = is_training_feature(ft) ? s.features[ft] : 0;
+            }
+            x[num_features] = 1;
+        };
+
+        auto dot = [](vec_type const& a, vec_type const& b) {
+            double r = 0;
+            for (size_t j = 0; j < dims; ++j) r += a[j] * b[j];
+            return r;
+        };
+
+        vec_type w, best_w;
+        w.fill(0);
+        best_w = w;
+        double penalty = lambda * samples.size();
+        double best_cost = std::numeric_limits<double>::max();
+
+        // each iteration evaluates the cost of w, and the last one does
+        // not update it
+        for (size_t iter = 0; iter <= max_iterations; ++iter) {
+            // accumulate the weighted Gram matrix and the current cost
+            std::vector<mat_type> thread_a(threads);
+            std::vector<vec_type> thread_c(threads);
+            std::vector<double> thread_cost(threads, 0);
+            std::vector<std::thread> workers;
+            for (size_t t = 0; t < threads; ++t) {
+                workers.emplace_back([&, t]() {
+                        mat_type& a = thread_a[t];
+                        vec_type& c = thread_c[t];
+                        for (auto& row: a) row.fill(0);
+                        c.fill(0);
+                        vec_type x;
+                        size_t begin = samples.size() * t / threads;
+                        size_t end = samples.size() * (t + 1) / threads;
+                        for (size_t i = begin; i < end; ++i) {
+                            get_x(samples[i], x);
+                            double res = dot(x, w) - samples[i].time;
+                            thread_cost[t] += std::abs(res) < eps
+                                ? res * res / (2 * eps)
+                                : std::abs(res) - eps / 2;
+                            // the first iteration is plain least squares
+                            double r = iter ? 1 / std::max(std::abs(res), eps) : 1;
+                            for (size_t j = 0; j < dims; ++j) {
+                                if (!x[j]) continue;
+                                for (size_t k = j; k < dims; ++k) {
+                                    a[j][k] += r * x[j] * x[k];
+                                }
+                                c[j] += r * x[j] * samples[i].time;
+                            }
+                        }
+                    });
+            }
+            for (auto& worker: workers) worker.join();
+
+            mat_type a;
+            vec_type c;
+            for (auto& row: a) row.fill(0);
+            c.fill(0);
+            double cost = 0;
+            for (size_t t = 0; t < threads; ++t) {
+                for (size_t j = 0; j < dims; ++j) {
+                    for (size_t k = j; k < dims; ++k) {
+                        a[j][k] += thread_a[t][j][k];
+                    }
+                    c[j] += thread_c[t][j];
+                }
+                cost += thread_cost[t];
+            }
+            for (size_t j = 0; j < dims; ++j) {
+                for (size_t k = 0; k < j; ++k) {
+                    a[j][k] = a[k][j];
+                }
+            }
+            for (size_t j = 0; j < num_features; ++j) {
+                cost += penalty * w[j];
+            }
+
+            bool improved = cost < best_cost * (1 - 1e-6);
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_w = w;
+            }
+            if ((iter > 1 && !improved) || iter == max_iterations) break;
+
+            // minimize 1/2 w'Aw - c'w + penalty * sum(w), with w >= 0
+            for (size_t sweep = 0; sweep < max_sweeps; ++sweep) {
+                double max_delta = 0;
+                for (size_t j = 0; j < dims; ++j) {
+                    if (a[j][j] <= 0) {
+                        w[j] = 0;
+                        continue;
+                    }
+                    double grad = dot(a[j], w) - c[j]
+                        + (j < num_features ? penalty : 0);
+                    double new_w = std::max(w[j] - grad / a[j][j], 0.0);
+                    max_delta = std::max(max_delta,
+                                         std::abs(new_w - w[j]) * std::sqrt(a[j][j]));
+                    w[j] = new_w;
+                }
+                if (max_delta < 1e-9 * std::sqrt(samples.size())) break;
+            }
+        }
+
+        for (size_t j = 0; j < num_features; ++j) {
+            result[(feature_type)j] = float(best_w[j]);
+        }
+        result.bias() = float(best_w[num_features]);
+        return result;
+    }
+
     bool read_block_stats(std::istream& is, uint32_t& list_id, std::vector<uint32_t>& block_counts)
     {
         thread_local std::string line;
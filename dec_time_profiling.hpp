@@ -0,0 +1,102 @@
+#pragma once
+
+#include <random>
+#include <vector>
+
+#include "mixed_block.hpp"
+#include "dec_time_prediction.hpp"
+#include "util.hpp"
+
+namespace ds2i {
+
+    // Decoding time of the encoded block in buf, in nanoseconds
+    double measure_decoding_time(size_t sum_of_values, size_t n,
+                                 std::vector<uint8_t> const& buf)
+    {
+        static const size_t runs = 256;
+        std::vector<uint32_t> out_buf(mixed_block::block_size);
+
+        // dry run to ignore one-time initializations (static variables, ...)
+        mixed_block::decode(buf.data(), out_buf.data(),
+                            sum_of_values, n);
+
+        size_t spacing = 1 << 10;
+        thread_local std::vector<uint8_t> readbuf(runs * spacing);
+        thread_local std::vector<uint8_t const*> positions(runs);
+        for (size_t run = 0; run < runs; ++run) {
+            // try random alignments
+            // XXX switch to c++ gens
+            uint8_t* position = readbuf.data() + run * spacing + (rand() % 64);
+            std::copy(buf.begin(), buf.end(), position);
+            positions[run] = position;
+        }
+
+        double tick = get_time_usecs();
+        for (auto position: positions) {
+            mixed_block::decode(position, out_buf.data(), sum_of_values, n);
+            do_not_optimize_away(out_buf[0]);
+        }
+
+        return (get_time_usecs() - tick) / runs * 1000;
+    }
+
+    // Encodes the block with each mixed_block type and parameter, and
+    // calls handler(type, time, features) with the measured decoding time
+    template <typename Handler>
+    void profile_block(std::vector<uint32_t> const& values,
+                       uint32_t sum_of_values,
+                       Handler&& handler)
+    {
+        using namespace time_prediction;
+        std::vector<uint8_t> buf;
+        uint32_t n = values.size();
+        feature_vector fv;
+        values_statistics(values, fv);
+
+        for (uint8_t t = 0; t < mixed_block::block_types; ++t) {
+            mixed_block::block_type type = (mixed_block::block_type)t;
+            for (mixed_block::compr_param_type param = 0;
+                 param < mixed_block::compr_params(type); ++param) {
+                buf.clear();
+                if (!mixed_block::compression_stats(type, param, values.data(),
+                                                    sum_of_values, n, buf, fv)) {
+                    continue;
+                }
+
+                double time = measure_decoding_time(sum_of_values, n, buf);
+                handler(t, time, fv);
+            }
+        }
+    }
+
+    // Profiles the docs and freqs of a fraction p of the full blocks of
+    // the index, chosen at random
+    template <typename IndexType, typename Handler>
+    void profile_sampled_blocks(IndexType const& index, double p,
+                                Handler&& handler)
+    {
+        std::default_random_engine rng(1729);
+        std::uniform_real_distribution<double> dist01(0.0, 1.0);
+
+        std::vector<uint32_t> values;
+
+        for (size_t l = 0; l < index.size(); ++l) {
+            if (l % 1000000 == 0) {
+                logger() << l << " lists processed" << std::endl;
+            }
+
+            auto blocks = index[l].get_blocks();
+            for (auto const& block: blocks) {
+                // only measure full blocks
+                if (block.size == mixed_block::block_size && dist01(rng) < p) {
+                    block.decode_doc_gaps(values);
+                    profile_block(values, block.doc_gaps_universe, handler);
+                    block.decode_freqs(values);
+                    profile_block(values, uint32_t(-1), handler);
+                }
+            }
+        }
+
+        logger() << index.size() << " lists processed" << std::endl;
+    }
+}
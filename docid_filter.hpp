@@ -0,0 +1,219 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <succinct/bit_vector.hpp>
+
+#include "compact_elias_fano.hpp"
+#include "global_parameters.hpp"
+#include "util.hpp"
+
+namespace ds2i {
+
+    // Filters restrict the query operators to a set of allowed docids,
+    // for example the documents in a language or visible to a tenant,
+    // which are checked before scoring instead of filtering the top-k
+    // afterwards. A filter gives a cursor whose next_geq(lower_bound)
+    // returns the first allowed docid greater than or equal to
+    // lower_bound, or a value not smaller than num_docs if there is
+    // none; the lower bounds must be non-decreasing. The conjunctive
+    // operators use the cursor as an additional list to intersect.
+
+    // Allows all the docids, and is optimized away
+    struct no_filter {
+        struct cursor {
+            uint64_t next_geq(uint64_t lower_bound)
+            {
+                return lower_bound;
+            }
+        };
+
+        cursor get_cursor() const
+        {
+            return cursor();
+        }
+    };
+
+    // Stores the allowed docids in a bitmap, for dense sets; a deny set
+    // is stored complemented. The bitmap has a sentinel bit at num_docs,
+    // so that the successor always exists.
+    class bitmap_filter {
+    public:
+        bitmap_filter()
+            : m_num_docs(0)
+        {}
+
+        template <typename DocsIterator>
+        bitmap_filter(uint64_t num_docs, DocsIterator begin, DocsIterator end,
+                      bool deny = false)
+            : m_num_docs(num_docs)
+        {
+            succinct::bit_vector_builder bvb(num_docs + 1, deny);
+            for (; begin != end; ++begin) {
+                if (uint64_t(*begin) >= num_docs) {
+                    throw std::invalid_argument("Docid out of range");
+                }
+                bvb.set(*begin, !deny);
+            }
+            bvb.set(num_docs, true);
+            succinct::bit_vector(&bvb).swap(m_bits);
+        }
+
+        class cursor {
+        public:
+            uint64_t DS2I_ALWAYSINLINE next_geq(uint64_t lower_bound)
+            {
+                if (DS2I_UNLIKELY(lower_bound >= m_bits->size())) {
+                    return lower_bound;
+                }
+                return m_bits->successor1(lower_bound);
+            }
+
+        private:
+            friend class bitmap_filter;
+
+            cursor(succinct::bit_vector const& bits)
+                : m_bits(&bits)
+            {}
+
+            succinct::bit_vector const* m_bits;
+        };
+
+        cursor get_cursor() const
+        {
+            return cursor(m_bits);
+        }
+
+        uint64_t num_docs() const
+        {
+            return m_num_docs;
+        }
+
+        void swap(bitmap_filter& other)
+        {
+            std::swap(m_num_docs, other.m_num_docs);
+            m_bits.swap(other.m_bits);
+        }
+
+        template <typename Visitor>
+        void map(Visitor& visit)
+        {
+            visit
+                (m_num_docs, "m_num_docs")
+                (m_bits, "m_bits")
+                ;
+        }
+
+    private:
+        uint64_t m_num_docs;
+        succinct::bit_vector m_bits;
+    };
+
+    // Stores the docids in an Elias-Fano sequence, for sparse allow or
+    // deny sets
+    class ef_filter {
+    public:
+        ef_filter()
+            : m_num_docs(0)
+            , m_size(0)
+            , m_deny(false)
+        {}
+
+        template <typename DocsIterator>
+        ef_filter(uint64_t num_docs, DocsIterator begin, DocsIterator end,
+                  bool deny = false)
+            : m_num_docs(num_docs)
+            , m_deny(deny)
+        {
+            std::vector<uint64_t> docs(begin, end);
+            std::sort(docs.begin(), docs.end());
+            docs.erase(std::unique(docs.begin(), docs.end()), docs.end());
+            if (!docs.empty() && docs.back() >= num_docs) {
+                throw std::invalid_argument("Docid out of range");
+            }
+            m_size = docs.size();
+            if (m_size) {
+                succinct::bit_vector_builder bvb;
+                compact_elias_fano::write(bvb, docs.begin(), num_docs,
+                                          m_size, m_params);
+                succinct::bit_vector(&bvb).swap(m_bits);
+            }
+        }
+
+        class cursor {
+        public:
+            uint64_t DS2I_ALWAYSINLINE next_geq(uint64_t lower_bound)
+            {
+                if (DS2I_UNLIKELY(!m_size)) {
+                    return m_deny ? lower_bound : m_num_docs;
+                }
+                auto val = m_enum.next_geq(lower_bound);
+                if (!m_deny) return val.second;
+                // skip the run of denied docids starting at lower_bound
+                while (val.second == lower_bound && lower_bound < m_num_docs) {
+                    lower_bound += 1;
+                    val = m_enum.next();
+                }
+                return lower_bound;
+            }
+
+        private:
+            friend class ef_filter;
+
+            cursor(ef_filter const& filter)
+                : m_num_docs(filter.m_num_docs)
+                , m_size(filter.m_size)
+                , m_deny(filter.m_deny)
+            {
+                if (m_size) {
+                    m_enum = compact_elias_fano::enumerator
+                        (filter.m_bits, 0, m_num_docs, m_size, filter.m_params);
+                }
+            }
+
+            uint64_t m_num_docs;
+            uint64_t m_size;
+            bool m_deny;
+            compact_elias_fano::enumerator m_enum;
+        };
+
+        cursor get_cursor() const
+        {
+            return cursor(*this);
+        }
+
+        uint64_t num_docs() const
+        {
+            return m_num_docs;
+        }
+
+        void swap(ef_filter& other)
+        {
+            std::swap(m_params, other.m_params);
+            std::swap(m_num_docs, other.m_num_docs);
+            std::swap(m_size, other.m_size);
+            std::swap(m_deny, other.m_deny);
+            m_bits.swap(other.m_bits);
+        }
+
+        template <typename Visitor>
+        void map(Visitor& visit)
+        {
+            visit
+                (m_params, "m_params")
+                (m_num_docs, "m_num_docs")
+                (m_size, "m_size")
+                (m_bits, "m_bits")
+                (m_deny, "m_deny")
+                ;
+        }
+
+    private:
+        global_parameters m_params;
+        uint64_t m_num_docs;
+        uint64_t m_size;
+        bool m_deny;
+        succinct::bit_vector m_bits;
+    };
+}
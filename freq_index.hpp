@@ -39,6 +39,21 @@ namespace ds2i {
                 m_queue.add_job(ptr, 2 * n);
             }
 
+            // See block_freq_index::builder::attach; the lists in the
+            // queue are committed before saving
+            void attach(checkpoint& ckpt, std::string const& name)
+            {
+                m_docs_sequences.attach(ckpt, name + ".docs");
+                m_freqs_sequences.attach(ckpt, name + ".freqs");
+            }
+
+            void save(checkpoint& ckpt, std::string const& name)
+            {
+                m_queue.complete();
+                m_docs_sequences.save(ckpt, name + ".docs");
+                m_freqs_sequences.save(ckpt, name + ".freqs");
+            }
+
             void build(freq_index& sq)
             {
                 m_queue.complete();
@@ -0,0 +1,294 @@
+#pragma once
+
+#include <boost/optional.hpp>
+
+#include <succinct/bit_vector.hpp>
+
+#include "compact_elias_fano.hpp"
+#include "global_parameters.hpp"
+
+namespace ds2i {
+
+    // Stores each posting list either in FirstIndex or in SecondIndex,
+    // so that for example short or rarely accessed lists can use a
+    // space-efficient representation and long hot lists a fast one. As in
+    // tiny_lists_index, the term ids of the lists in SecondIndex are
+    // stored in an Elias-Fano sequence, whose rank gives the ids in the
+    // two indexes. The representation can be chosen explicitly for each
+    // list (see create_hybrid_index); otherwise the lists with at least
+    // default_length_threshold postings go to SecondIndex.
+    template <typename FirstIndex, typename SecondIndex>
+    class hybrid_lists_index {
+    public:
+        typedef FirstIndex first_index_type;
+        typedef SecondIndex second_index_type;
+
+        enum representation {
+            first_representation = 0,
+            second_representation = 1
+        };
+
+        static const uint64_t default_length_threshold = 1 << 12;
+
+        hybrid_lists_index()
+            : m_size(0)
+            , m_num_docs(0)
+            , m_num_second(0)
+        {}
+
+        class builder {
+        public:
+            builder(uint64_t num_docs, global_parameters const& params)
+                : m_params(params)
+                , m_num_docs(num_docs)
+                , m_size(0)
+                , m_first_builder(num_docs, params)
+                , m_second_builder(num_docs, params)
+            {}
+
+            template <typename DocsIterator, typename FreqsIterator>
+            void add_posting_list(uint64_t n, DocsIterator docs_begin,
+                                  FreqsIterator freqs_begin, uint64_t occurrences)
+            {
+                add_posting_list(n, docs_begin, freqs_begin, occurrences,
+                                 n >= default_length_threshold
+                                 ? second_representation : first_representation);
+            }
+
+            template <typename DocsIterator, typename FreqsIterator>
+            void add_posting_list(uint64_t n, DocsIterator docs_begin,
+                                  FreqsIterator freqs_begin, uint64_t occurrences,
+                                  representation repr)
+            {
+                if (!n) throw std::invalid_argument("List must be nonempty");
+
+                if (repr == second_representation) {
+                    m_second_builder.add_posting_list(n, docs_begin, freqs_begin,
+                                                      occurrences);
+                    m_second_ids.push_back(m_size);
+                } else {
+                    m_first_builder.add_posting_list(n, docs_begin, freqs_begin,
+                                                     occurrences);
+                }
+                m_size += 1;
+            }
+
+            void build(hybrid_lists_index& sq)
+            {
+                sq.m_params = m_params;
+                sq.m_size = m_size;
+                sq.m_num_docs = m_num_docs;
+                sq.m_num_second = m_second_ids.size();
+
+                if (sq.m_num_second) {
+                    succinct::bit_vector_builder ids_bvb;
+                    compact_elias_fano::write(ids_bvb, m_second_ids.begin(),
+                                              m_size, sq.m_num_second,
+                                              m_params);
+                    succinct::bit_vector(&ids_bvb).swap(sq.m_second_ids);
+                }
+
+                // empty indexes are left default-constructed
+                if (sq.m_num_second < m_size) {
+                    m_first_builder.build(sq.m_first);
+                }
+                if (sq.m_num_second) {
+                    m_second_builder.build(sq.m_second);
+                }
+            }
+
+        private:
+            global_parameters m_params;
+            uint64_t m_num_docs;
+            uint64_t m_size;
+            typename FirstIndex::builder m_first_builder;
+            typename SecondIndex::builder m_second_builder;
+            std::vector<uint64_t> m_second_ids;
+        };
+
+        size_t size() const
+        {
+            return m_size;
+        }
+
+        uint64_t num_docs() const
+        {
+            return m_num_docs;
+        }
+
+        uint64_t num_second_lists() const
+        {
+            return m_num_second;
+        }
+
+        FirstIndex const& first() const
+        {
+            return m_first;
+        }
+
+        FirstIndex& first()
+        {
+            return m_first;
+        }
+
+        SecondIndex const& second() const
+        {
+            return m_second;
+        }
+
+        SecondIndex& second()
+        {
+            return m_second;
+        }
+
+        typedef typename FirstIndex::document_enumerator first_enumerator;
+        typedef typename SecondIndex::document_enumerator second_enumerator;
+
+        class document_enumerator {
+        public:
+            void reset()
+            {
+                if (m_second_enum) {
+                    m_second_enum->reset();
+                } else {
+                    m_first_enum->reset();
+                }
+            }
+
+            void DS2I_ALWAYSINLINE next()
+            {
+                if (m_second_enum) {
+                    m_second_enum->next();
+                } else {
+                    m_first_enum->next();
+                }
+            }
+
+            void DS2I_ALWAYSINLINE next_geq(uint64_t lower_bound)
+            {
+                if (m_second_enum) {
+                    m_second_enum->next_geq(lower_bound);
+                } else {
+                    m_first_enum->next_geq(lower_bound);
+                }
+            }
+
+            void DS2I_ALWAYSINLINE move(uint64_t position)
+            {
+                if (m_second_enum) {
+                    m_second_enum->move(position);
+                } else {
+                    m_first_enum->move(position);
+                }
+            }
+
+            uint64_t docid() const
+            {
+                return m_second_enum ? m_second_enum->docid() : m_first_enum->docid();
+            }
+
+            uint64_t DS2I_ALWAYSINLINE freq()
+            {
+                return m_second_enum ? m_second_enum->freq() : m_first_enum->freq();
+            }
+
+            uint64_t position() const
+            {
+                return m_second_enum ? m_second_enum->position() : m_first_enum->position();
+            }
+
+            uint64_t size() const
+            {
+                return m_second_enum ? m_second_enum->size() : m_first_enum->size();
+            }
+
+            representation repr() const
+            {
+                return m_second_enum ? second_representation : first_representation;
+            }
+
+        private:
+            friend class hybrid_lists_index;
+
+            document_enumerator(first_enumerator const& e)
+                : m_first_enum(e)
+            {}
+
+            document_enumerator(second_enumerator const& e)
+                : m_second_enum(e)
+            {}
+
+            boost::optional<first_enumerator> m_first_enum;
+            boost::optional<second_enumerator> m_second_enum;
+        };
+
+        document_enumerator operator[](size_t i) const
+        {
+            assert(i < size());
+            uint64_t rank = 0;
+            if (m_num_second) {
+                auto second = second_ids_enum().next_geq(i);
+                if (second.second == i) {
+                    return document_enumerator(m_second[second.first]);
+                }
+                rank = second.first;
+            }
+            return document_enumerator(m_first[i - rank]);
+        }
+
+        void warmup(size_t i) const
+        {
+            assert(i < size());
+            uint64_t rank = 0;
+            if (m_num_second) {
+                auto second = second_ids_enum().next_geq(i);
+                if (second.second == i) {
+                    m_second.warmup(second.first);
+                    return;
+                }
+                rank = second.first;
+            }
+            m_first.warmup(i - rank);
+        }
+
+        void swap(hybrid_lists_index& other)
+        {
+            std::swap(m_params, other.m_params);
+            std::swap(m_size, other.m_size);
+            std::swap(m_num_docs, other.m_num_docs);
+            std::swap(m_num_second, other.m_num_second);
+            m_second_ids.swap(other.m_second_ids);
+            m_first.swap(other.m_first);
+            m_second.swap(other.m_second);
+        }
+
+        template <typename Visitor>
+        void map(Visitor& visit)
+        {
+            visit
+                (m_params, "m_params")
+                (m_size, "m_size")
+                (m_num_docs, "m_num_docs")
+                (m_num_second, "m_num_second")
+                (m_second_ids, "m_second_ids")
+                (m_first, "m_first")
+                (m_second, "m_second")
+                ;
+        }
+
+    private:
+        compact_elias_fano::enumerator second_ids_enum() const
+        {
+            return compact_elias_fano::enumerator(m_second_ids, 0, m_size,
+                                                  m_num_second, m_params);
+        }
+
+        global_parameters m_params;
+        uint64_t m_size;
+        uint64_t m_num_docs;
+        uint64_t m_num_second;
+        succinct::bit_vector m_second_ids;
+        FirstIndex m_first;
+        SecondIndex m_second;
+    };
+}
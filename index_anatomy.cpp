@@ -0,0 +1,471 @@
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <array>
+#include <numeric>
+
+#include <succinct/mapper.hpp>
+
+#include "configuration.hpp"
+#include "index_types.hpp"
+#include "index_build_utils.hpp"
+#include "util.hpp"
+
+// Breaks down the space and the decoding time of an index by list
+// length: the lists are bucketed by floor(log2(length)), and for each
+// bucket it reports the bits per posting (without the per-list overhead
+// of the index directory, as posting_list_size) and the time to decode
+// docids and frequencies per posting. For the indexes based on
+// indexed_sequence it also reports how many partitions, and postings,
+// are encoded with each representation, and for block_mixed how many
+// blocks use each codec. The lists are analyzed on DS2I_THREADS threads,
+// while the decoding is timed in a separate pass on a single thread, so
+// that the timings are not inflated by the other threads.
+
+namespace ds2i {
+
+    // Size in bits of the i-th list of the index, whose postings are docs
+    // and freqs. The lists are re-encoded from their postings, so the
+    // wrappers can forward them to their base indexes, where the list ids
+    // are different
+    template <typename DocsSequence, typename FreqsSequence>
+    uint64_t list_bits(freq_index<DocsSequence, FreqsSequence> const& index,
+                       size_t /* i */,
+                       std::vector<uint64_t> const& docs,
+                       std::vector<uint64_t> const& freqs)
+    {
+        uint64_t occurrences = std::accumulate(freqs.begin(), freqs.end(),
+                                               uint64_t(0));
+        return posting_list_size<freq_index<DocsSequence, FreqsSequence>>
+            ::bits(index.params(), index.num_docs(), docs.size(),
+                   docs.begin(), freqs.begin(), occurrences);
+    }
+
+    template <typename BlockCodec, bool Profile>
+    uint64_t list_bits(block_freq_index<BlockCodec, Profile> const& index,
+                       size_t /* i */,
+                       std::vector<uint64_t> const& docs,
+                       std::vector<uint64_t> const& freqs)
+    {
+        return posting_list_size<block_freq_index<BlockCodec, Profile>>
+            ::bits(global_parameters(), index.num_docs(), docs.size(),
+                   docs.begin(), freqs.begin(), 0);
+    }
+
+    // The codecs of the mixed blocks are chosen by optimal_hybrid_index,
+    // so the stored blocks are copied instead of re-encoding the list
+    template <bool Profile>
+    uint64_t list_bits(block_freq_index<mixed_block, Profile> const& index,
+                       size_t i,
+                       std::vector<uint64_t> const& /* docs */,
+                       std::vector<uint64_t> const& /* freqs */)
+    {
+        auto e = index[i];
+        std::vector<uint8_t> buf;
+        block_posting_list<mixed_block, Profile>::write_blocks(buf, e.size(),
+                                                               e.get_blocks());
+        return 8 * buf.size();
+    }
+
+    template <typename BaseIndex, size_t MaxTinySize>
+    uint64_t list_bits(tiny_lists_index<BaseIndex, MaxTinySize> const& index,
+                       size_t i,
+                       std::vector<uint64_t> const& docs,
+                       std::vector<uint64_t> const& freqs)
+    {
+        if (docs.size() > MaxTinySize) {
+            return list_bits(index.base(), i, docs, freqs);
+        }
+        // re-encode the directory entry
+        std::vector<uint8_t> buf;
+        TightVariableByte::encode_single(docs.size(), buf);
+        for (size_t p = 0; p < docs.size(); ++p) {
+            TightVariableByte::encode_single(p ? docs[p] - docs[p - 1] - 1 : docs[p],
+                                             buf);
+        }
+        for (auto freq: freqs) {
+            TightVariableByte::encode_single(freq - 1, buf);
+        }
+        return 8 * buf.size();
+    }
+
+    template <typename FirstIndex, typename SecondIndex>
+    uint64_t list_bits(hybrid_lists_index<FirstIndex, SecondIndex> const& index,
+                       size_t i,
+                       std::vector<uint64_t> const& docs,
+                       std::vector<uint64_t> const& freqs)
+    {
+        typedef hybrid_lists_index<FirstIndex, SecondIndex> index_type;
+        if (index[i].repr() == index_type::second_representation) {
+            return list_bits(index.second(), i, docs, freqs);
+        }
+        return list_bits(index.first(), i, docs, freqs);
+    }
+
+    template <typename BaseIndex>
+    uint64_t list_bits(bitmap_lists_index<BaseIndex> const& index,
+                       size_t i,
+                       std::vector<uint64_t> const& docs,
+                       std::vector<uint64_t> const& freqs)
+    {
+        uint64_t bits = list_bits(index.base(), i, docs, freqs);
+        if (index[i].has_bitmap()) {
+            bits += (index.num_docs() + 63) / 64 * 64;
+        }
+        return bits;
+    }
+
+    // Number of partitions (or blocks) and of postings for each
+    // representation
+    struct mix_counts {
+        static const size_t types = 3;
+
+        mix_counts()
+        {
+            parts.fill(0);
+            postings.fill(0);
+        }
+
+        void add(size_t type, uint64_t n)
+        {
+            assert(type < types);
+            parts[type] += 1;
+            postings[type] += n;
+        }
+
+        void merge(mix_counts const& other)
+        {
+            for (size_t t = 0; t < types; ++t) {
+                parts[t] += other.parts[t];
+                postings[t] += other.postings[t];
+            }
+        }
+
+        std::array<uint64_t, types> parts;
+        std::array<uint64_t, types> postings;
+    };
+
+    template <typename Sequence>
+    struct sequence_mix {
+        static bool supported() { return false; }
+        static void count(typename Sequence::enumerator const&, mix_counts&) {}
+    };
+
+    template <typename Sequence>
+    struct typed_sequence_mix {
+        static bool supported() { return true; }
+        static void count(typename Sequence::enumerator const& e, mix_counts& counts)
+        {
+            counts.add(e.type(), e.size());
+        }
+    };
+
+    template <>
+    struct sequence_mix<indexed_sequence>
+        : typed_sequence_mix<indexed_sequence> {};
+
+    template <>
+    struct sequence_mix<strict_sequence>
+        : typed_sequence_mix<strict_sequence> {};
+
+    template <typename Sequence>
+    struct partitions_mix {
+        typedef typename Sequence::base_sequence_type base_sequence_type;
+
+        static bool supported()
+        {
+            return sequence_mix<base_sequence_type>::supported();
+        }
+
+        static void count(typename Sequence::enumerator e, mix_counts& counts)
+        {
+            e.move(0);
+            while (true) {
+                sequence_mix<base_sequence_type>::count(e.partition_enum(), counts);
+                if (e.partition_end() == e.size()) break;
+                e.move(e.partition_end());
+            }
+        }
+    };
+
+    template <typename BaseSequence>
+    struct sequence_mix<partitioned_sequence<BaseSequence>>
+        : partitions_mix<partitioned_sequence<BaseSequence>> {};
+
+    template <typename BaseSequence>
+    struct sequence_mix<uniform_partitioned_sequence<BaseSequence>>
+        : partitions_mix<uniform_partitioned_sequence<BaseSequence>> {};
+
+    template <typename BaseSequence>
+    struct sequence_mix<positive_sequence<BaseSequence>> {
+        static bool supported()
+        {
+            return sequence_mix<BaseSequence>::supported();
+        }
+
+        static void count(typename positive_sequence<BaseSequence>::enumerator const& e,
+                          mix_counts& counts)
+        {
+            sequence_mix<BaseSequence>::count(e.base(), counts);
+        }
+    };
+
+    template <typename Index>
+    struct index_mix {
+        static bool supported() { return false; }
+        static const char* name(size_t) { return ""; }
+        static void count(Index const&, size_t, mix_counts&, mix_counts&) {}
+    };
+
+    template <typename DocsSequence, typename FreqsSequence>
+    struct index_mix<freq_index<DocsSequence, FreqsSequence>> {
+        static bool supported()
+        {
+            return sequence_mix<DocsSequence>::supported();
+        }
+
+        static const char* name(size_t type)
+        {
+            static const char* names[] = {"elias_fano", "ranked_bitvector", "all_ones"};
+            return names[type];
+        }
+
+        static void count(freq_index<DocsSequence, FreqsSequence> const& index,
+                          size_t i, mix_counts& docs, mix_counts& freqs)
+        {
+            auto e = index[i];
+            sequence_mix<DocsSequence>::count(e.docs_enum(), docs);
+            sequence_mix<FreqsSequence>::count(e.freqs_enum(), freqs);
+        }
+    };
+
+    template <bool Profile>
+    struct index_mix<block_freq_index<mixed_block, Profile>> {
+        static bool supported() { return true; }
+
+        static const char* name(size_t type)
+        {
+            static const char* names[] = {"pfor", "varint", "interpolative"};
+            return names[type];
+        }
+
+        static void count(block_freq_index<mixed_block, Profile> const& index,
+                          size_t i, mix_counts& docs, mix_counts& freqs)
+        {
+            auto e = index[i];
+            std::vector<uint8_t> buf;
+            for (auto const& block: e.get_blocks()) {
+                // partial blocks are interpolative and have no type byte
+                size_t type = size_t(mixed_block::block_type::interpolative);
+                if (block.size == mixed_block::block_size) {
+                    buf.clear();
+                    block.append_docs_block(buf);
+                    type = buf[0];
+                }
+                docs.add(type, block.size);
+                if (block.size == mixed_block::block_size) {
+                    buf.clear();
+                    block.append_freqs_block(buf);
+                    type = buf[0];
+                }
+                freqs.add(type, block.size);
+            }
+        }
+    };
+
+    struct bucket_stats {
+        bucket_stats()
+            : lists(0)
+            , postings(0)
+            , bits(0)
+            , decode_ns(0)
+        {}
+
+        void merge(bucket_stats const& other)
+        {
+            lists += other.lists;
+            postings += other.postings;
+            bits += other.bits;
+            decode_ns += other.decode_ns;
+        }
+
+        uint64_t lists;
+        uint64_t postings;
+        uint64_t bits;
+        double decode_ns;
+    };
+
+    struct anatomy {
+        static const size_t buckets = 64;
+
+        anatomy()
+            : lengths(buckets)
+        {}
+
+        void merge(anatomy const& other)
+        {
+            for (size_t b = 0; b < buckets; ++b) {
+                lengths[b].merge(other.lengths[b]);
+            }
+            docs_mix.merge(other.docs_mix);
+            freqs_mix.merge(other.freqs_mix);
+        }
+
+        std::vector<bucket_stats> lengths;
+        mix_counts docs_mix;
+        mix_counts freqs_mix;
+    };
+
+    // Time in nanoseconds to decode the docids and frequencies of the
+    // i-th list
+    template <typename IndexType>
+    double decode_list_ns(IndexType const& index, size_t i)
+    {
+        typedef std::chrono::high_resolution_clock clock_type;
+
+        auto e = index[i];
+        uint64_t n = e.size();
+        uint64_t sum = 0;
+        auto tick = clock_type::now();
+        for (size_t p = 0; p < n; ++p, e.next()) {
+            sum += e.docid() + e.freq();
+        }
+        auto elapsed = clock_type::now() - tick;
+        do_not_optimize_away(sum);
+        return double(std::chrono::duration_cast
+                      <std::chrono::nanoseconds>(elapsed).count());
+    }
+
+    template <typename IndexType>
+    void analyze_list(IndexType const& index, size_t i, anatomy& stats,
+                      std::vector<uint64_t>& docs, std::vector<uint64_t>& freqs)
+    {
+        auto e = index[i];
+        uint64_t n = e.size();
+        docs.clear();
+        freqs.clear();
+        for (size_t p = 0; p < n; ++p, e.next()) {
+            docs.push_back(e.docid());
+            freqs.push_back(e.freq());
+        }
+
+        auto& bucket = stats.lengths[succinct::broadword::msb(n)];
+        bucket.lists += 1;
+        bucket.postings += n;
+        bucket.bits += list_bits(index, i, docs, freqs);
+
+        index_mix<IndexType>::count(index, i, stats.docs_mix, stats.freqs_mix);
+    }
+
+    template <typename IndexType>
+    void index_anatomy(const char* index_filename, std::string const& type)
+    {
+        IndexType index;
+        logger() << "Loading index from " << index_filename << std::endl;
+        boost::iostreams::mapped_file_source m(index_filename);
+        succinct::mapper::map(index, m);
+
+        size_t n_threads = std::max(configuration::get().worker_threads, size_t(1));
+        logger() << "Analyzing " << index.size() << " lists on "
+                 << n_threads << " threads" << std::endl;
+        std::vector<anatomy> thread_stats(n_threads);
+        std::vector<std::thread> threads(n_threads);
+        for (size_t tid = 0; tid < n_threads; ++tid) {
+            threads[tid] = std::thread([&, tid]() {
+                    std::vector<uint64_t> docs, freqs;
+                    for (size_t i = tid; i < index.size(); i += n_threads) {
+                        analyze_list(index, i, thread_stats[tid], docs, freqs);
+                    }
+                });
+        }
+        for (auto& thread: threads) thread.join();
+
+        anatomy stats;
+        for (auto const& s: thread_stats) stats.merge(s);
+
+        logger() << "Timing the decoding on a single thread" << std::endl;
+        for (size_t i = 0; i < index.size(); ++i) {
+            auto& bucket = stats.lengths[succinct::broadword::msb(index[i].size())];
+            bucket.decode_ns += decode_list_ns(index, i);
+        }
+
+        bucket_stats total;
+        for (size_t b = 0; b < anatomy::buckets; ++b) {
+            auto const& bucket = stats.lengths[b];
+            total.merge(bucket);
+            if (!bucket.lists) continue;
+            double bits_per_posting = double(bucket.bits) / bucket.postings;
+            double ns_per_posting = bucket.decode_ns / bucket.postings;
+            logger() << "Lengths [" << (uint64_t(1) << b) << ", "
+                     << (uint64_t(2) << b) << "): " << bucket.lists << " lists, "
+                     << bucket.postings << " postings, "
+                     << bits_per_posting << " bits per posting, "
+                     << ns_per_posting << " ns per posting" << std::endl;
+
+            stats_line()
+                ("type", type)
+                ("min_length", uint64_t(1) << b)
+                ("lists", bucket.lists)
+                ("postings", bucket.postings)
+                ("bits_per_posting", bits_per_posting)
+                ("decode_ns_per_posting", ns_per_posting)
+                ;
+        }
+
+        stats_line()
+            ("type", type)
+            ("lists", total.lists)
+            ("postings", total.postings)
+            ("bits_per_posting", double(total.bits) / total.postings)
+            ("decode_ns_per_posting", total.decode_ns / total.postings)
+            ;
+
+        if (index_mix<IndexType>::supported()) {
+            for (size_t t = 0; t < mix_counts::types; ++t) {
+                char const* name = index_mix<IndexType>::name(t);
+                logger() << name << ": docs " << stats.docs_mix.parts[t]
+                         << " parts, " << stats.docs_mix.postings[t]
+                         << " postings; freqs " << stats.freqs_mix.parts[t]
+                         << " parts, " << stats.freqs_mix.postings[t]
+                         << " postings" << std::endl;
+
+                stats_line()
+                    ("type", type)
+                    ("representation", name)
+                    ("docs_parts", stats.docs_mix.parts[t])
+                    ("docs_postings", stats.docs_mix.postings[t])
+                    ("freqs_parts", stats.freqs_mix.parts[t])
+                    ("freqs_postings", stats.freqs_mix.postings[t])
+                    ;
+            }
+        }
+    }
+}
+
+int main(int argc, const char** argv)
+{
+    using namespace ds2i;
+
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <index type> <index filename>"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string type = argv[1];
+    const char* index_filename = argv[2];
+
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                           \
+        } else if (type == BOOST_PP_STRINGIZE(T)) {     \
+            index_anatomy<BOOST_PP_CAT(T, _index)>      \
+                (index_filename, type);                 \
+            /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_INDEX_TYPES);
+#undef LOOP_BODY
+    } else {
+        logger() << "ERROR: Unknown type " << type << std::endl;
+    }
+}
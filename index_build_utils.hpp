@@ -1,6 +1,9 @@
 #pragma once
 
+#include <memory>
+
 #include "index_types.hpp"
+#include "checkpoint.hpp"
 #include "util.hpp"
 #include "succinct/mapper.hpp"
 
@@ -65,6 +68,277 @@ namespace ds2i {
         docs_size = total_size - freqs_size;
     }
 
+    template <typename BaseIndex, size_t MaxTinySize>
+    void get_size_stats(tiny_lists_index<BaseIndex, MaxTinySize>& coll,
+                        uint64_t& docs_size, uint64_t& freqs_size)
+    {
+        get_size_stats(coll.base(), docs_size, freqs_size);
+
+        auto size_tree = succinct::mapper::size_tree_of(coll);
+        uint64_t tiny_size = 0;
+        for (auto const& node: size_tree->children) {
+            if (node->name == "m_tiny_ids" ||
+                node->name == "m_tiny_endpoints" ||
+                node->name == "m_tiny_lists") {
+                tiny_size += node->size;
+            }
+        }
+
+        // the tiny freqs are not stored separately, so re-encode them to
+        // count their bytes
+        uint64_t tiny_freqs_size = 0;
+        std::vector<uint8_t> buf;
+        for (size_t i = 0; i < coll.size(); ++i) {
+            auto e = coll[i];
+            if (!e.is_tiny()) continue;
+            buf.clear();
+            for (size_t pos = 0; pos < e.size(); ++pos, e.next()) {
+                TightVariableByte::encode_single(e.freq() - 1, buf);
+            }
+            tiny_freqs_size += buf.size();
+        }
+
+        logger() << coll.num_tiny_lists() << " tiny lists: "
+                 << tiny_size << " bytes" << std::endl;
+        docs_size += tiny_size - tiny_freqs_size;
+        freqs_size += tiny_freqs_size;
+    }
+
+    template <typename FirstIndex, typename SecondIndex>
+    void get_size_stats(hybrid_lists_index<FirstIndex, SecondIndex>& coll,
+                        uint64_t& docs_size, uint64_t& freqs_size)
+    {
+        docs_size = freqs_size = 0;
+        if (coll.num_second_lists() < coll.size()) {
+            get_size_stats(coll.first(), docs_size, freqs_size);
+        }
+        if (coll.num_second_lists()) {
+            uint64_t second_docs_size = 0, second_freqs_size = 0;
+            get_size_stats(coll.second(), second_docs_size, second_freqs_size);
+            docs_size += second_docs_size;
+            freqs_size += second_freqs_size;
+        }
+    }
+
+    template <typename BaseIndex>
+    void get_size_stats(bitmap_lists_index<BaseIndex>& coll,
+                        uint64_t& docs_size, uint64_t& freqs_size)
+    {
+        get_size_stats(coll.base(), docs_size, freqs_size);
+
+        auto size_tree = succinct::mapper::size_tree_of(coll);
+        uint64_t bitmaps_size = 0;
+        for (auto const& node: size_tree->children) {
+            if (node->name == "m_bitmap_ids" ||
+                node->name == "m_bitmaps") {
+                bitmaps_size += node->size;
+            }
+        }
+
+        logger() << coll.num_bitmaps() << " bitmaps: "
+                 << bitmaps_size << " bytes" << std::endl;
+        docs_size += bitmaps_size;
+    }
+
+    template <typename BaseIndex>
+    void get_size_stats(two_tier_index<BaseIndex>& coll,
+                        uint64_t& docs_size, uint64_t& freqs_size)
+    {
+        docs_size = freqs_size = 0;
+        if (coll.size()) {
+            get_size_stats(coll.high(), docs_size, freqs_size);
+        }
+        if (coll.num_split_lists()) {
+            uint64_t low_docs_size = 0, low_freqs_size = 0;
+            get_size_stats(coll.low(), low_docs_size, low_freqs_size);
+            docs_size += low_docs_size;
+            freqs_size += low_freqs_size;
+        }
+    }
+
+    // The field frequencies are counted separately, see
+    // create_multi_field_index
+    template <typename Index, typename FieldsSequence>
+    void get_size_stats(multi_field_index<Index, FieldsSequence>& coll,
+                        uint64_t& docs_size, uint64_t& freqs_size)
+    {
+        get_size_stats(coll.index(), docs_size, freqs_size);
+    }
+
+    // Size in bits of a single posting list encoded as in IndexType,
+    // without the per-list overhead of the index directory
+    template <typename IndexType>
+    struct posting_list_size;
+
+    template <typename DocsSequence, typename FreqsSequence>
+    struct posting_list_size<freq_index<DocsSequence, FreqsSequence>> {
+        template <typename DocsIterator, typename FreqsIterator>
+        static uint64_t bits(global_parameters const& params, uint64_t num_docs,
+                             uint64_t n, DocsIterator docs_begin,
+                             FreqsIterator freqs_begin, uint64_t occurrences)
+        {
+            succinct::bit_vector_builder bvb;
+            write_gamma_nonzero(bvb, occurrences);
+            if (occurrences > 1) {
+                bvb.append_bits(n, ceil_log2(occurrences + 1));
+            }
+            DocsSequence::write(bvb, docs_begin, num_docs, n, params);
+            FreqsSequence::write(bvb, freqs_begin, occurrences + 1, n, params);
+            return bvb.size();
+        }
+    };
+
+    template <typename BlockCodec, bool Profile>
+    struct posting_list_size<block_freq_index<BlockCodec, Profile>> {
+        template <typename DocsIterator, typename FreqsIterator>
+        static uint64_t bits(global_parameters const& /* params */,
+                             uint64_t /* num_docs */,
+                             uint64_t n, DocsIterator docs_begin,
+                             FreqsIterator freqs_begin, uint64_t /* occurrences */)
+        {
+            std::vector<uint8_t> buf;
+            block_posting_list<BlockCodec, Profile>::write(buf, n, docs_begin,
+                                                           freqs_begin);
+            return 8 * buf.size();
+        }
+    };
+
+    // The index types whose builder can be resumed from a checkpoint
+    template <typename Collection>
+    struct is_resumable : std::false_type {};
+
+    template <typename DocsSequence, typename FreqsSequence>
+    struct is_resumable<freq_index<DocsSequence, FreqsSequence>>
+        : std::true_type {};
+
+    template <typename BlockCodec, bool Profile>
+    struct is_resumable<block_freq_index<BlockCodec, Profile>>
+        : std::true_type {};
+
+    // If DS2I_CHECKPOINT_DIR is set, saves every
+    // DS2I_CHECKPOINT_INTERVAL seconds the state of an index builder,
+    // together with the number of lists added and the progress counters,
+    // so that a build restarted after a crash resumes from the last
+    // checkpoint; the caller skips the first resumed_lists() lists. The
+    // checkpoint is identified by build_id (for example the index type)
+    // and the number of documents, which must match to resume.
+    template <typename Collection,
+              bool Resumable = is_resumable<Collection>::value>
+    class build_checkpointer {
+    public:
+        typedef typename Collection::builder builder_type;
+
+        build_checkpointer(std::string const& build_id, uint64_t,
+                           progress_logger&)
+        {
+            if (!configuration::get().checkpoint_dir.empty()) {
+                logger() << "WARNING: checkpoints are not supported by "
+                         << build_id << ", building from scratch" << std::endl;
+            }
+        }
+
+        checkpoint* state()
+        {
+            return nullptr;
+        }
+
+        void attach(builder_type&) {}
+
+        uint64_t resumed_lists() const
+        {
+            return 0;
+        }
+
+        bool due() const
+        {
+            return false;
+        }
+
+        void save(builder_type&, uint64_t) {}
+
+        void complete() {}
+    };
+
+    template <typename Collection>
+    class build_checkpointer<Collection, true> {
+    public:
+        typedef typename Collection::builder builder_type;
+
+        build_checkpointer(std::string const& build_id, uint64_t num_docs,
+                           progress_logger& plog)
+            : m_plog(plog)
+            , m_resumed_lists(0)
+        {
+            std::string const& dir = configuration::get().checkpoint_dir;
+            if (dir.empty()) return;
+
+            m_ckpt.reset(new checkpoint(dir));
+            if (m_ckpt->resumed()) {
+                if (m_ckpt->get<std::string>("build_id") != build_id ||
+                    m_ckpt->get<uint64_t>("num_docs") != num_docs) {
+                    throw std::runtime_error("The checkpoint in " + dir +
+                                             " belongs to another build");
+                }
+                if (m_ckpt->has("lists")) {
+                    m_resumed_lists = m_ckpt->get<uint64_t>("lists");
+                    m_plog.sequences = m_resumed_lists;
+                    m_plog.postings = m_ckpt->get<uint64_t>("postings");
+                }
+                logger() << "Resuming from the checkpoint in " << dir
+                         << " after " << m_resumed_lists << " lists" << std::endl;
+            } else {
+                m_ckpt->set("build_id", build_id);
+                m_ckpt->set("num_docs", num_docs);
+            }
+        }
+
+        // The checkpoint, for the state of the caller; null if
+        // checkpoints are disabled
+        checkpoint* state()
+        {
+            return m_ckpt.get();
+        }
+
+        // Must be called before adding any list to the builder
+        void attach(builder_type& builder)
+        {
+            if (m_ckpt) builder.attach(*m_ckpt, "index");
+        }
+
+        uint64_t resumed_lists() const
+        {
+            return m_resumed_lists;
+        }
+
+        bool due() const
+        {
+            return m_ckpt && m_ckpt->due();
+        }
+
+        // lists is the number of lists committed to the builder, all
+        // counted in the progress logger
+        void save(builder_type& builder, uint64_t lists)
+        {
+            if (!m_ckpt) return;
+            builder.save(*m_ckpt, "index");
+            m_ckpt->set("lists", lists);
+            m_ckpt->set("postings", m_plog.postings);
+            m_ckpt->commit();
+            logger() << "Checkpoint saved after " << lists << " lists" << std::endl;
+        }
+
+        // Removes the checkpoint once the index is built
+        void complete()
+        {
+            if (m_ckpt) m_ckpt->remove();
+        }
+
+    private:
+        std::unique_ptr<checkpoint> m_ckpt;
+        progress_logger& m_plog;
+        uint64_t m_resumed_lists;
+    };
+
     template <typename Collection>
     void dump_stats(Collection& coll,
                     std::string const& type,
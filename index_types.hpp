@@ -8,10 +8,16 @@
 #include "positive_sequence.hpp"
 #include "partitioned_sequence.hpp"
 #include "uniform_partitioned_sequence.hpp"
+#include "auto_sampling_sequence.hpp"
 #include "binary_freq_collection.hpp"
 #include "block_freq_index.hpp"
 #include "block_codecs.hpp"
 #include "mixed_block.hpp"
+#include "tiny_lists_index.hpp"
+#include "hybrid_lists_index.hpp"
+#include "multi_field_index.hpp"
+#include "bitmap_lists_index.hpp"
+#include "two_tier_index.hpp"
 
 namespace ds2i {
 
@@ -31,12 +37,35 @@ namespace ds2i {
         positive_sequence<partitioned_sequence<strict_sequence>>
         > opt_index;
 
+    typedef freq_index<auto_sampling_sequence<compact_elias_fano>,
+                       positive_sequence<strict_elias_fano>> ef_auto_sampling_index;
+
+    typedef freq_index<
+        auto_sampling_sequence<partitioned_sequence<>>,
+        positive_sequence<partitioned_sequence<strict_sequence>>
+        > opt_auto_sampling_index;
+
     typedef block_freq_index<ds2i::optpfor_block> block_optpfor_index;
     typedef block_freq_index<ds2i::varint_G8IU_block> block_varint_index;
     typedef block_freq_index<ds2i::interpolative_block> block_interpolative_index;
     typedef block_freq_index<ds2i::qmx_block> block_qmx_index;
     typedef block_freq_index<ds2i::mixed_block> block_mixed_index;
+
+    typedef tiny_lists_index<opt_index> tiny_opt_index;
+    typedef tiny_lists_index<block_optpfor_index> tiny_block_optpfor_index;
+
+    typedef hybrid_lists_index<opt_index, block_qmx_index> hybrid_index;
+
+    typedef bitmap_lists_index<block_optpfor_index> bitmap_block_optpfor_index;
+
+    typedef two_tier_index<opt_index> two_tier_opt_index;
+    typedef two_tier_index<block_optpfor_index> two_tier_block_optpfor_index;
+
+    typedef multi_field_index<opt_index> multi_field_opt_index;
+    typedef multi_field_index<block_optpfor_index> multi_field_block_optpfor_index;
 }
 
-#define DS2I_INDEX_TYPES (ef)(single)(uniform)(opt)(block_optpfor)(block_varint)(block_interpolative)(block_mixed)(block_qmx)
+#define DS2I_INDEX_TYPES (ef)(single)(uniform)(opt)(block_optpfor)(block_varint)(block_interpolative)(block_mixed)(block_qmx)(tiny_opt)(tiny_block_optpfor)(ef_auto_sampling)(opt_auto_sampling)(hybrid)(bitmap_block_optpfor)
+#define DS2I_MULTI_FIELD_INDEX_TYPES (multi_field_opt)(multi_field_block_optpfor)
+#define DS2I_TWO_TIER_INDEX_TYPES (two_tier_opt)(two_tier_block_optpfor)
 #define DS2I_BLOCK_INDEX_TYPES (block_optpfor)(block_varint)(block_interpolative)(block_qmx)(block_mixed)
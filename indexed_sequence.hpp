@@ -154,6 +154,11 @@ namespace ds2i {
 #undef ENUMERATOR_METHOD
 #undef ENUMERATOR_VOID_METHOD
 
+            index_type type() const
+            {
+                return m_type;
+            }
+
         private:
             index_type m_type;
             union {
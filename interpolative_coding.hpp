@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <stdint.h>
 
@@ -121,6 +122,9 @@ namespace ds2i {
             return val;
         }
 
+        // Equivalent to the recursive definition mirrored by
+        // write_interpolative, but the pending right subtrees are kept on an
+        // explicit stack, and small or forced subtrees are decoded inline.
         void read_interpolative(uint32_t* out,
                                 size_t n,
                                 uint32_t low,
@@ -129,19 +133,49 @@ namespace ds2i {
             assert(low <= high);
             assert(n > 0);
 
-            size_t h = n / 2;
-            uint32_t val = low + read_int(high - low + 1);
-            out[h] = val;
-            if (n == 1) {
-                // optimization to avoid two unpredictable ifs
-                return;
-            }
-            // the two ifs are a bit ugly but it is faster than postponing them
-            if (h) {
-                read_interpolative(out, h, low, val);
-            }
-            if (n - h - 1) {
-                read_interpolative(out + h + 1, n - h - 1, val, high);
+            struct subtree {
+                uint32_t* out;
+                size_t n;
+                uint32_t low;
+                uint32_t high;
+            };
+            // the depth of the recursion is logarithmic in n
+            subtree stack[64];
+            size_t top = 0;
+
+            while (true) {
+                if (low == high) {
+                    // all the values are forced, so nothing was written
+                    std::fill(out, out + n, low);
+                } else if (n == 1) {
+                    out[0] = low + read_int(high - low + 1);
+                } else if (n == 2) {
+                    uint32_t val = low + read_int(high - low + 1);
+                    out[1] = val;
+                    out[0] = low + read_int(val - low + 1);
+                } else if (n == 3) {
+                    uint32_t val = low + read_int(high - low + 1);
+                    out[1] = val;
+                    out[0] = low + read_int(val - low + 1);
+                    out[2] = val + read_int(high - val + 1);
+                } else {
+                    size_t h = n / 2;
+                    uint32_t val = low + read_int(high - low + 1);
+                    out[h] = val;
+                    // right subtree is decoded after the left one
+                    assert(top < sizeof(stack) / sizeof(stack[0]));
+                    stack[top++] = subtree { out + h + 1, n - h - 1, val, high };
+                    n = h;
+                    high = val;
+                    continue;
+                }
+
+                if (!top) break;
+                --top;
+                out = stack[top].out;
+                n = stack[top].n;
+                low = stack[top].low;
+                high = stack[top].high;
             }
         }
 
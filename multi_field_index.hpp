@@ -0,0 +1,245 @@
+#pragma once
+
+#include <vector>
+
+#include "bitvector_collection.hpp"
+#include "integer_codes.hpp"
+#include "global_parameters.hpp"
+#include "positive_sequence.hpp"
+
+namespace ds2i {
+
+    // Adds to Index the frequency of each posting in up to max_fields
+    // fields (see binary_multi_field_collection). Index stores the docids
+    // and the total frequencies, so the lists can be used as they are by
+    // all the query operators; the frequencies in the first F - 1 fields
+    // are stored, incremented by one, in a FieldsSequence per list, with
+    // the F frequencies of each posting contiguous, while the last field
+    // is obtained by difference with the total.
+    template <typename Index, typename FieldsSequence = positive_sequence<>>
+    class multi_field_index {
+    public:
+        typedef Index index_type;
+
+        static const uint64_t max_fields = 16;
+
+        multi_field_index()
+            : m_num_fields(0)
+        {}
+
+        class builder {
+        public:
+            builder(uint64_t num_docs, uint64_t num_fields,
+                    global_parameters const& params)
+                : m_params(params)
+                , m_num_fields(num_fields)
+                , m_index_builder(num_docs, params)
+                , m_fields_sequences(params)
+            {
+                if (!num_fields || num_fields > max_fields) {
+                    throw std::invalid_argument("Invalid number of fields");
+                }
+            }
+
+            // fields_begin iterates over the n * F field frequencies
+            template <typename DocsIterator, typename FreqsIterator,
+                      typename FieldsIterator>
+            void add_posting_list(uint64_t n, DocsIterator docs_begin,
+                                  FreqsIterator freqs_begin, uint64_t occurrences,
+                                  FieldsIterator fields_begin)
+            {
+                if (!n) throw std::invalid_argument("List must be nonempty");
+
+                uint64_t stored_fields = m_num_fields - 1;
+                if (stored_fields) {
+                    succinct::bit_vector_builder fields_bits;
+                    m_fields_buf.clear();
+                    uint64_t fields_occurrences = 0;
+                    for (uint64_t i = 0; i < n; ++i, fields_begin += m_num_fields) {
+                        for (uint64_t f = 0; f < stored_fields; ++f) {
+                            m_fields_buf.push_back(uint64_t(*(fields_begin + f)) + 1);
+                            fields_occurrences += m_fields_buf.back();
+                        }
+                    }
+
+                    write_gamma_nonzero(fields_bits, fields_occurrences);
+                    FieldsSequence::write(fields_bits, m_fields_buf.begin(),
+                                          fields_occurrences + 1,
+                                          m_fields_buf.size(), m_params);
+                    m_fields_sequences.append(fields_bits);
+                }
+
+                m_index_builder.add_posting_list(n, docs_begin, freqs_begin,
+                                                 occurrences);
+            }
+
+            void build(multi_field_index& sq)
+            {
+                sq.m_params = m_params;
+                sq.m_num_fields = m_num_fields;
+                // with a single field there is nothing to store
+                if (m_num_fields > 1) {
+                    m_fields_sequences.build(sq.m_fields_sequences);
+                }
+                m_index_builder.build(sq.m_index);
+            }
+
+        private:
+            global_parameters m_params;
+            uint64_t m_num_fields;
+            typename Index::builder m_index_builder;
+            bitvector_collection::builder m_fields_sequences;
+            std::vector<uint64_t> m_fields_buf;
+        };
+
+        size_t size() const
+        {
+            return m_index.size();
+        }
+
+        uint64_t num_docs() const
+        {
+            return m_index.num_docs();
+        }
+
+        uint64_t num_fields() const
+        {
+            return m_num_fields;
+        }
+
+        Index const& index() const
+        {
+            return m_index;
+        }
+
+        Index& index()
+        {
+            return m_index;
+        }
+
+        typedef typename Index::document_enumerator index_enumerator;
+
+        class document_enumerator {
+        public:
+            void reset()
+            {
+                m_enum.reset();
+            }
+
+            void DS2I_ALWAYSINLINE next()
+            {
+                m_enum.next();
+            }
+
+            void DS2I_ALWAYSINLINE next_geq(uint64_t lower_bound)
+            {
+                m_enum.next_geq(lower_bound);
+            }
+
+            void DS2I_ALWAYSINLINE move(uint64_t position)
+            {
+                m_enum.move(position);
+            }
+
+            uint64_t docid() const
+            {
+                return m_enum.docid();
+            }
+
+            uint64_t DS2I_ALWAYSINLINE freq()
+            {
+                return m_enum.freq();
+            }
+
+            // Writes the frequencies of the current posting in the
+            // num_fields() fields
+            void DS2I_FLATTEN_FUNC field_freqs(uint64_t* freqs)
+            {
+                uint64_t stored_fields = m_num_fields - 1;
+                uint64_t last = m_enum.freq();
+                uint64_t offset = m_enum.position() * stored_fields;
+                for (uint64_t f = 0; f < stored_fields; ++f) {
+                    freqs[f] = m_fields_enum.move(offset + f).second - 1;
+                    last -= freqs[f];
+                }
+                freqs[stored_fields] = last;
+            }
+
+            uint64_t position() const
+            {
+                return m_enum.position();
+            }
+
+            uint64_t size() const
+            {
+                return m_enum.size();
+            }
+
+            uint64_t num_fields() const
+            {
+                return m_num_fields;
+            }
+
+        private:
+            friend class multi_field_index;
+
+            document_enumerator(index_enumerator const& e, uint64_t num_fields,
+                                typename FieldsSequence::enumerator fields_enum)
+                : m_enum(e)
+                , m_num_fields(num_fields)
+                , m_fields_enum(fields_enum)
+            {}
+
+            index_enumerator m_enum;
+            uint64_t m_num_fields;
+            typename FieldsSequence::enumerator m_fields_enum;
+        };
+
+        document_enumerator operator[](size_t i) const
+        {
+            assert(i < size());
+            typename FieldsSequence::enumerator fields_enum;
+            if (m_num_fields > 1) {
+                auto fields_it = m_fields_sequences.get(m_params, i);
+                uint64_t fields_occurrences = read_gamma_nonzero(fields_it);
+                auto e = m_index[i];
+                fields_enum = typename FieldsSequence::enumerator
+                    (m_fields_sequences.bits(), fields_it.position(),
+                     fields_occurrences + 1, e.size() * (m_num_fields - 1),
+                     m_params);
+                return document_enumerator(e, m_num_fields, fields_enum);
+            }
+            return document_enumerator(m_index[i], m_num_fields, fields_enum);
+        }
+
+        void warmup(size_t i) const
+        {
+            m_index.warmup(i);
+        }
+
+        void swap(multi_field_index& other)
+        {
+            std::swap(m_params, other.m_params);
+            std::swap(m_num_fields, other.m_num_fields);
+            m_fields_sequences.swap(other.m_fields_sequences);
+            m_index.swap(other.m_index);
+        }
+
+        template <typename Visitor>
+        void map(Visitor& visit)
+        {
+            visit
+                (m_params, "m_params")
+                (m_num_fields, "m_num_fields")
+                (m_fields_sequences, "m_fields_sequences")
+                (m_index, "m_index")
+                ;
+        }
+
+    private:
+        global_parameters m_params;
+        uint64_t m_num_fields;
+        bitvector_collection m_fields_sequences;
+        Index m_index;
+    };
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stdexcept>
+#include <vector>
+
+#include <succinct/mappable_vector.hpp>
+
+#include "bm25.hpp"
+#include "util.hpp"
+
+namespace ds2i {
+
+    // Scoring data for a multi_field_index, with the same interface used
+    // by the query operators as wand_data. For each document and field it
+    // stores the field weight normalized by the field length, so that
+    // scoring a posting only takes a dot product with its field
+    // frequencies; the max term weights are computed with these norms, so
+    // WAND and MaxScore bounds take into account the fields.
+    template <typename Scorer = bm25f>
+    class multi_field_wand_data {
+    public:
+        typedef Scorer scorer_type;
+        typedef float const* doc_norms_type;
+
+        static const uint64_t max_fields = 16;
+
+        multi_field_wand_data()
+            : m_num_fields(0)
+        {}
+
+        // field_lengths[f] iterates over the lengths of field f in the
+        // documents; the collection sequences must have a fields member
+        // as in binary_multi_field_collection
+        template <typename LengthsIterator, typename InputCollection>
+        multi_field_wand_data(std::vector<LengthsIterator> field_lengths,
+                              uint64_t num_docs,
+                              InputCollection const& coll,
+                              std::vector<float> const& field_weights,
+                              std::vector<float> const& field_b)
+            : m_num_fields(field_lengths.size())
+        {
+            if (!m_num_fields || m_num_fields > max_fields ||
+                field_weights.size() != m_num_fields ||
+                field_b.size() != m_num_fields) {
+                throw std::invalid_argument("Invalid number of fields");
+            }
+
+            std::vector<float> field_norms(num_docs * m_num_fields);
+            logger() << "Reading sizes..." << std::endl;
+            for (uint64_t f = 0; f < m_num_fields; ++f) {
+                double lens_sum = 0;
+                for (size_t i = 0; i < num_docs; ++i) {
+                    float len = *field_lengths[f]++;
+                    field_norms[i * m_num_fields + f] = len;
+                    lens_sum += len;
+                }
+                float avg_len = float(lens_sum / double(num_docs));
+                for (size_t i = 0; i < num_docs; ++i) {
+                    float& norm = field_norms[i * m_num_fields + f];
+                    norm = Scorer::field_norm(field_weights[f], field_b[f],
+                                              avg_len ? norm / avg_len : 0);
+                }
+            }
+
+            logger() << "Storing max weight for each list..." << std::endl;
+            std::vector<float> max_term_weight;
+            for (auto const& seq: coll) {
+                float max_score = 0;
+                auto fields_it = seq.fields.begin();
+                for (size_t i = 0; i < seq.docs.size(); ++i) {
+                    uint64_t docid = *(seq.docs.begin() + i);
+                    float pseudo_freq = 0;
+                    for (uint64_t f = 0; f < m_num_fields; ++f, ++fields_it) {
+                        pseudo_freq += float(*fields_it)
+                            * field_norms[docid * m_num_fields + f];
+                    }
+                    float score = Scorer::doc_term_weight(pseudo_freq);
+                    max_score = std::max(max_score, score);
+                }
+                max_term_weight.push_back(max_score);
+                if ((max_term_weight.size() % 1000000) == 0) {
+                    logger() << max_term_weight.size() << " list processed" << std::endl;
+                }
+            }
+            logger() << max_term_weight.size() << " list processed" << std::endl;
+
+            m_field_norms.steal(field_norms);
+            m_max_term_weight.steal(max_term_weight);
+        }
+
+        uint64_t num_fields() const
+        {
+            return m_num_fields;
+        }
+
+        float max_term_weight(uint64_t term_id) const
+        {
+            return m_max_term_weight[term_id];
+        }
+
+        doc_norms_type doc_norms(uint64_t doc_id) const
+        {
+            return &m_field_norms[doc_id * m_num_fields];
+        }
+
+        template <typename Enumerator>
+        float doc_term_weight(Enumerator& e, doc_norms_type norms) const
+        {
+            assert(e.num_fields() == m_num_fields);
+            uint64_t freqs[max_fields];
+            e.field_freqs(freqs);
+            float pseudo_freq = 0;
+            for (uint64_t f = 0; f < m_num_fields; ++f) {
+                pseudo_freq += float(freqs[f]) * norms[f];
+            }
+            return Scorer::doc_term_weight(pseudo_freq);
+        }
+
+        void swap(multi_field_wand_data& other)
+        {
+            std::swap(m_num_fields, other.m_num_fields);
+            m_field_norms.swap(other.m_field_norms);
+            m_max_term_weight.swap(other.m_max_term_weight);
+        }
+
+        template <typename Visitor>
+        void map(Visitor& visit)
+        {
+            visit
+                (m_num_fields, "m_num_fields")
+                (m_field_norms, "m_field_norms")
+                (m_max_term_weight, "m_max_term_weight")
+                ;
+        }
+
+    private:
+        uint64_t m_num_fields;
+        succinct::mapper::mappable_vector<float> m_field_norms;
+        succinct::mapper::mappable_vector<float> m_max_term_weight;
+    };
+
+}
@@ -22,12 +22,66 @@
 
 using ds2i::logger;
 
-typedef uint32_t block_id_type; // XXX for memory reasons, but would need size_t for very large indexes
+typedef uint64_t block_id_type;
 
+// The representation chosen for a block, packed in a byte as the
+// parameter (less than 32) and the type in the 3 high bits
+struct block_choice {
+    static uint8_t pack(ds2i::mixed_block::block_type type,
+                        ds2i::mixed_block::compr_param_type param)
+    {
+        assert(param < 32);
+        return uint8_t((uint8_t)type << 5 | param);
+    }
+
+    static ds2i::mixed_block::block_type type(uint8_t choice)
+    {
+        return ds2i::mixed_block::block_type(choice >> 5);
+    }
+
+    static ds2i::mixed_block::compr_param_type param(uint8_t choice)
+    {
+        return choice & 31;
+    }
+};
+
+// A point of the space-time frontier of a block, with the lambda at
+// which it is chosen. The block id, the space and the block_choice are
+// packed in a single word, so that a point takes 16 bytes with block
+// ids up to 2^40 (there are as many points as the lambdas file holds)
 struct lambda_point {
-    block_id_type block_id;
+    static const block_id_type max_blocks = block_id_type(1) << 40;
+
+    lambda_point() {}
+
+    lambda_point(block_id_type block_id, float lambda,
+                 ds2i::mixed_block::space_time_point const& st)
+        : lambda(lambda)
+        , time(st.time)
+        , m_bits(block_id
+                 | uint64_t(st.space) << 40
+                 | uint64_t(block_choice::pack(st.type, st.param)) << 56)
+    {
+        assert(block_id < max_blocks);
+    }
+
+    block_id_type block_id() const
+    {
+        return m_bits & (max_blocks - 1);
+    }
+
+    uint16_t space() const
+    {
+        return uint16_t(m_bits >> 40);
+    }
+
+    uint8_t choice() const
+    {
+        return uint8_t(m_bits >> 56);
+    }
+
     float lambda;
-    ds2i::mixed_block::space_time_point st;
+    float time;
 
     struct comparator {
         bool operator()(lambda_point const& lhs, lambda_point const& rhs) const
@@ -49,10 +103,48 @@ struct lambda_point {
             return val;
         }
     };
+
+private:
+    uint64_t m_bits;
 };
 
+static_assert(sizeof(lambda_point) == 16, "lambda_point should be packed in 16 bytes");
+
 typedef stxxl::vector<lambda_point> lambda_vector_type;
 
+// The lambdas file holds raw lambda_points, so its format is recorded in
+// a file next to it, written only once the points are sorted; a lambdas
+// file without it was written by another version, or is incomplete
+static const std::string lambdas_version = "ds2i_lambdas 2 "
+    + boost::lexical_cast<std::string>(sizeof(lambda_point));
+
+std::string lambdas_version_filename(const char* lambdas_filename)
+{
+    return std::string(lambdas_filename) + ".version";
+}
+
+void write_lambdas_version(const char* lambdas_filename)
+{
+    std::ofstream fout(lambdas_version_filename(lambdas_filename).c_str());
+    fout << lambdas_version << std::endl;
+    if (!fout) {
+        throw std::runtime_error("Error writing "
+                                 + lambdas_version_filename(lambdas_filename));
+    }
+}
+
+void check_lambdas_version(const char* lambdas_filename)
+{
+    std::ifstream fin(lambdas_version_filename(lambdas_filename).c_str());
+    std::string version;
+    std::getline(fin, version);
+    if (version != lambdas_version) {
+        throw std::runtime_error(std::string("Lambdas file ") + lambdas_filename
+                                 + " was written by another version or is incomplete"
+                                 + ", remove it to recompute the lambdas");
+    }
+}
+
 template <typename InputCollectionType>
 struct lambdas_computer : ds2i::semiasync_queue::job {
     lambdas_computer(block_id_type block_id_base,
@@ -97,17 +189,17 @@ struct lambdas_computer : ds2i::semiasync_queue::job {
                 std::sort(points.begin(), points.end());
 
                 // smallest point is always added with lambda=0
-                m_points_buf.push_back(lambda_point { block_id, 0, points.front() });
+                m_points_buf.push_back(lambda_point(block_id, 0, points.front()));
                 for (auto const& cur: points) {
                     while (true) {
                         auto const& prev = m_points_buf.back();
                         // if this point is dominated we can skip it
-                        if (cur.time >= prev.st.time) break;
-                        auto lambda = (cur.space - prev.st.space) / (prev.st.time - cur.time);
+                        if (cur.time >= prev.time) break;
+                        auto lambda = (cur.space - prev.space()) / (prev.time - cur.time);
                         if (!heuristic_greedy && lambda < prev.lambda) {
                             m_points_buf.pop_back();
                         } else {
-                            m_points_buf.push_back(lambda_point { block_id, lambda, cur });
+                            m_points_buf.push_back(lambda_point(block_id, lambda, cur));
                             break;
                         }
                     }
@@ -253,15 +345,14 @@ template <typename InputCollectionType, typename CollectionBuilder>
 struct list_transformer : ds2i::semiasync_queue::job {
     list_transformer(CollectionBuilder& b,
                      typename InputCollectionType::document_enumerator e,
-                     std::vector<ds2i::mixed_block::block_type>::const_iterator block_type_begin,
-                     std::vector<ds2i::mixed_block::compr_param_type>::const_iterator block_param_begin,
+                     std::vector<uint8_t>& block_choices,
                      ds2i::progress_logger& plog)
         : m_b(b)
         , m_e(e)
-        , m_block_type(block_type_begin)
-        , m_block_param(block_param_begin)
         , m_plog(plog)
-    {}
+    {
+        m_block_choices.swap(block_choices);
+    }
 
     virtual void prepare()
     {
@@ -271,19 +362,22 @@ struct list_transformer : ds2i::semiasync_queue::job {
         typedef mixed_block::block_transformer<input_block_type> output_block_type;
 
         auto blocks = m_e.get_blocks();
+        assert(m_block_choices.size() == 2 * blocks.size());
         std::vector<output_block_type> output_blocks;
 
+        auto choice = m_block_choices.begin();
         for (auto const& input_block: blocks) {
-            auto docs_type = *m_block_type++;
-            auto freqs_type = *m_block_type++;
-            auto docs_param = *m_block_param++;
-            auto freqs_param = *m_block_param++;
+            auto docs_choice = *choice++;
+            auto freqs_choice = *choice++;
             output_blocks.emplace_back(input_block,
-                                       docs_type, freqs_type,
-                                       docs_param, freqs_param);
+                                       block_choice::type(docs_choice),
+                                       block_choice::type(freqs_choice),
+                                       block_choice::param(docs_choice),
+                                       block_choice::param(freqs_choice));
         }
 
         block_posting_list<mixed_block>::write_blocks(m_buf, m_e.size(), output_blocks);
+        succinct::util::dispose(m_block_choices);
     }
 
     virtual void commit()
@@ -294,52 +388,37 @@ struct list_transformer : ds2i::semiasync_queue::job {
 
     CollectionBuilder& m_b;
     typename InputCollectionType::document_enumerator m_e;
-    std::vector<ds2i::mixed_block::block_type>::const_iterator m_block_type;
-    std::vector<ds2i::mixed_block::compr_param_type>::const_iterator m_block_param;
+    std::vector<uint8_t> m_block_choices;
     ds2i::progress_logger& m_plog;
     std::vector<uint8_t> m_buf;
 };
 
 
+// Chooses the representation of each block greedily by increasing
+// lambda, as long as the space is within the budget, and stores it in
+// block_choices packed with block_choice; with a zero budget the
+// trade-offs are written to output_filename, and false is returned.
 template <typename InputCollectionType>
-void optimal_hybrid_index(ds2i::global_parameters const& params,
-                          const char* predictors_filename,
-                          const char* block_stats_filename,
-                          const char* input_filename,
-                          const char* output_filename,
-                          const char* lambdas_filename,
-                          size_t budget)
+bool choose_block_types(InputCollectionType const& input_coll,
+                        size_t num_blocks, size_t partial_blocks,
+                        size_t space_base,
+                        const char* predictors_filename,
+                        const char* block_stats_filename,
+                        const char* output_filename,
+                        const char* lambdas_filename,
+                        size_t budget,
+                        std::vector<uint8_t>& block_choices)
 {
     using namespace ds2i;
 
-    InputCollectionType input_coll;
-    boost::iostreams::mapped_file_source m(input_filename);
-    succinct::mapper::map(input_coll, m);
-
-    logger() << "Processing " << input_coll.size() << " posting lists" << std::endl;
-    size_t num_blocks = 0;
-    size_t partial_blocks = 0;
-    size_t space_base = 8; // space overhead independent of block compression method
-    for (size_t l = 0; l < input_coll.size(); ++l) {
-        auto e = input_coll[l];
-        num_blocks += 2 * e.num_blocks();
-        // list length in vbyte
-        space_base += succinct::util::ceil_div(succinct::broadword::msb(e.size()) + 1, 7);
-        space_base += e.num_blocks() * 4; // max docid
-        space_base += (e.num_blocks() - 1) * 4; // endpoint
-        if (e.size() % mixed_block::block_size != 0) {
-            partial_blocks += 2;
-        }
-    }
-
-    logger() << num_blocks << " overall blocks" << std::endl;
-
     if (boost::filesystem::exists(lambdas_filename)) {
         logger() << "Found lambdas file " << lambdas_filename << ", skipping recomputation" << std::endl;
         logger() << "To recompute lambdas, remove file" << std::endl;
+        check_lambdas_version(lambdas_filename);
     } else {
         compute_lambdas(input_coll, num_blocks, predictors_filename,
                         block_stats_filename, lambdas_filename);
+        write_lambdas_version(lambdas_filename);
     }
 
     stxxl::syscall_file lpfile(lambdas_filename,
@@ -352,8 +431,7 @@ void optimal_hybrid_index(ds2i::global_parameters const& params,
     logger() << "Computing space-time tradeoffs" << std::endl;
     std::vector<uint16_t> block_spaces(num_blocks);
     std::vector<float> block_times(num_blocks);
-    std::vector<mixed_block::block_type> block_types(num_blocks);
-    std::vector<mixed_block::compr_param_type> block_params(num_blocks);
+    block_choices.assign(num_blocks, block_choice::pack(mixed_block::block_type(), 0));
     size_t cur_space = space_base;
     double cur_time = 0;
     size_t seen_lambdas = 0;
@@ -365,17 +443,21 @@ void optimal_hybrid_index(ds2i::global_parameters const& params,
     }
 
     for (auto const& lpid: lambda_vector_type::bufreader_type(lambda_points)) {
-        assert(lpid.block_id < num_blocks);
-        cur_space -= block_spaces[lpid.block_id];
-        cur_time -= block_times[lpid.block_id];
+        block_id_type block_id = lpid.block_id();
+        if (block_id >= num_blocks) {
+            // for example a lambdas file computed on another index
+            throw std::runtime_error(std::string("Invalid lambdas file ") + lambdas_filename
+                                     + ", remove it to recompute the lambdas");
+        }
+        cur_space -= block_spaces[block_id];
+        cur_time -= block_times[block_id];
 
-        block_spaces[lpid.block_id] = lpid.st.space;
-        block_times[lpid.block_id] = lpid.st.time;
-        block_types[lpid.block_id] = lpid.st.type;
-        block_params[lpid.block_id] = lpid.st.param;
+        block_spaces[block_id] = lpid.space();
+        block_times[block_id] = lpid.time;
+        block_choices[block_id] = lpid.choice();
 
-        cur_space += block_spaces[lpid.block_id];
-        cur_time += block_times[lpid.block_id];
+        cur_space += block_spaces[block_id];
+        cur_time += block_times[block_id];
 
         if (lpid.lambda > 0) { // we are past the initial frontier
             if (first_nonzero_lambda) {
@@ -400,7 +482,7 @@ void optimal_hybrid_index(ds2i::global_parameters const& params,
 
     if (budget == 0) {
         logger() << "Done" << std::endl;
-        return; // done, just reporting the trade-offs
+        return false; // done, just reporting the trade-offs
     }
 
     double elapsed_secs = (get_time_usecs() - tick) / 1000000;
@@ -422,7 +504,8 @@ void optimal_hybrid_index(ds2i::global_parameters const& params,
     typedef std::tuple<uint32_t, uint32_t> type_param_pair;
     std::map<type_param_pair, size_t> type_counts;
     for (size_t i = 0; i < num_blocks; ++i) {
-        type_counts[type_param_pair((uint8_t)block_types[i], block_params[i])] += 1;
+        type_counts[type_param_pair((uint8_t)block_choice::type(block_choices[i]),
+                                    block_choice::param(block_choices[i]))] += 1;
     }
 
     std::vector<std::pair<type_param_pair, size_t>> type_counts_vec;
@@ -439,39 +522,137 @@ void optimal_hybrid_index(ds2i::global_parameters const& params,
         ("type_counts", type_counts_vec)
         ;
 
-    tick = get_time_usecs();
-    user_tick = get_user_time_usecs();
+    return true;
+}
 
-    typedef typename block_mixed_index::builder builder_type;
-    builder_type builder(input_coll.num_docs(), params);
-    progress_logger plog;
-    semiasync_queue queue(1 << 24);
-    auto block_types_it = block_types.begin();
-    auto block_params_it = block_params.begin();
+template <typename InputCollectionType>
+void optimal_hybrid_index(ds2i::global_parameters const& params,
+                          const char* predictors_filename,
+                          const char* block_stats_filename,
+                          const char* input_filename,
+                          const char* output_filename,
+                          const char* lambdas_filename,
+                          size_t budget)
+{
+    using namespace ds2i;
+
+    InputCollectionType input_coll;
+    boost::iostreams::mapped_file_source m(input_filename);
+    succinct::mapper::map(input_coll, m);
 
+    logger() << "Processing " << input_coll.size() << " posting lists" << std::endl;
+    size_t num_blocks = 0;
+    size_t partial_blocks = 0;
+    size_t space_base = 8; // space overhead independent of block compression method
     for (size_t l = 0; l < input_coll.size(); ++l) {
         auto e = input_coll[l];
+        num_blocks += 2 * e.num_blocks();
+        // list length in vbyte
+        space_base += succinct::util::ceil_div(succinct::broadword::msb(e.size()) + 1, 7);
+        space_base += e.num_blocks() * 4; // max docid
+        space_base += (e.num_blocks() - 1) * 4; // endpoint
+        if (e.size() % mixed_block::block_size != 0) {
+            partial_blocks += 2;
+        }
+    }
 
-        typedef list_transformer<InputCollectionType, builder_type> job_type;
-        std::shared_ptr<job_type> job(new job_type(builder, e,
-                                                   block_types_it,
-                                                   block_params_it,
-                                                   plog));
+    logger() << num_blocks << " overall blocks" << std::endl;
+    if (num_blocks > lambda_point::max_blocks) {
+        throw std::runtime_error("Too many blocks");
+    }
 
-        block_types_it += 2 * e.num_blocks();
-        block_params_it += 2 * e.num_blocks();
-        queue.add_job(job, 2 * e.size());
+    // the block choices are written to a file and read back one list at
+    // a time by the construction, so that they are not in memory
+    // together with the builder; with checkpoints the file is saved in
+    // the checkpoint, so that a resumed build goes straight to the
+    // construction
+    progress_logger plog;
+    build_checkpointer<block_mixed_index>
+        ckpt("optimal_hybrid_" + boost::lexical_cast<std::string>(budget),
+             input_coll.num_docs(), plog);
+    checkpoint* state = ckpt.state();
+    std::string choices_filename = state
+        ? state->filename("block_choices")
+        : std::string(lambdas_filename) + ".choices";
+    if (state && state->has("block_choices.size")) {
+        logger() << "Found the block choices in the checkpoint, skipping the greedy"
+                 << std::endl;
+    } else {
+        std::vector<uint8_t> block_choices;
+        if (!choose_block_types(input_coll, num_blocks, partial_blocks, space_base,
+                                predictors_filename, block_stats_filename,
+                                output_filename, lambdas_filename, budget,
+                                block_choices)) {
+            return;
+        }
+        if (state) {
+            state->save_vector("block_choices", block_choices);
+            state->commit();
+        } else {
+            std::ofstream fout(choices_filename.c_str(), std::ios::binary);
+            fout.write(reinterpret_cast<const char*>(block_choices.data()),
+                       block_choices.size());
+            fout.close();
+            if (!fout) {
+                throw std::runtime_error("Error writing " + choices_filename);
+            }
+        }
     }
 
-    assert(block_types_it == block_types.end());
-    assert(block_params_it == block_params.end());
+    double tick = get_time_usecs();
+    double user_tick = get_user_time_usecs();
+
+    // the lists are streamed to a file next to the output (unless
+    // DS2I_SPILL_DIR is set), and copied after the endpoints when the
+    // index is frozen
+    std::string spill = spill_filename();
+    if (spill.empty() && output_filename) {
+        spill = std::string(output_filename) + ".lists";
+    }
+    typedef typename block_mixed_index::builder builder_type;
+    builder_type builder(input_coll.num_docs(), params, spill);
+    ckpt.attach(builder);
+    semiasync_queue queue(1 << 24);
+    std::ifstream choices(choices_filename.c_str(), std::ios::binary);
+
+    for (size_t l = 0; l < input_coll.size(); ++l) {
+        auto e = input_coll[l];
+        size_t list_blocks = 2 * e.num_blocks();
+
+        // skip the lists added before the checkpoint
+        if (l >= ckpt.resumed_lists()) {
+            std::vector<uint8_t> block_choices(list_blocks);
+            choices.read(reinterpret_cast<char*>(block_choices.data()), list_blocks);
+            typedef list_transformer<InputCollectionType, builder_type> job_type;
+            std::shared_ptr<job_type> job(new job_type(builder, e,
+                                                       block_choices,
+                                                       plog));
+            queue.add_job(job, 2 * e.size());
+
+            if (ckpt.due()) {
+                // the lists are committed to the builder by the queue
+                queue.complete();
+                ckpt.save(builder, l + 1);
+            }
+        } else {
+            choices.seekg(list_blocks, std::ios::cur);
+        }
+    }
+
+    if (!choices) {
+        throw std::runtime_error("Truncated block choices file " + choices_filename);
+    }
+    choices.close();
     queue.complete();
     plog.log();
 
     block_mixed_index coll;
     builder.build(coll);
-    elapsed_secs = (get_time_usecs() - tick) / 1000000;
-    user_elapsed_secs = (get_user_time_usecs() - user_tick) / 1000000;
+    if (!state) {
+        std::remove(choices_filename.c_str());
+    }
+    double elapsed_secs = (get_time_usecs() - tick) / 1000000;
+    double user_elapsed_secs = (get_user_time_usecs() - user_tick) / 1000000;
     logger() << "Collection built in "
              << elapsed_secs << " seconds" << std::endl;
 
@@ -485,6 +666,9 @@ void optimal_hybrid_index(ds2i::global_parameters const& params,
     if (output_filename) {
         succinct::mapper::freeze(coll, output_filename);
     }
+    // the checkpoint is kept until the index is written, since its data
+    // files are mapped into coll
+    ckpt.complete();
 }
 
 
@@ -235,6 +235,18 @@ namespace ds2i {
                 return m_partitions;
             }
 
+            // The enumerator of the current partition, and the position
+            // where the partition ends
+            base_sequence_enumerator const& partition_enum() const
+            {
+                return m_partition_enum;
+            }
+
+            uint64_t partition_end() const
+            {
+                return m_cur_end;
+            }
+
             friend class partitioned_sequence_test;
 
         private:
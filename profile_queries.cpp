@@ -53,7 +53,8 @@ void profile(const char* index_filename,
              const char* wand_data_filename,
              std::vector<ds2i::term_id_vec> const& queries,
              std::string const& type,
-             std::string const& query_type)
+             std::string const& query_type,
+             uint64_t k)
 {
     using namespace ds2i;
 
@@ -79,11 +80,11 @@ void profile(const char* index_filename,
         if (t == "and") {
             op_profile(index, and_query<false>(), queries);
         } else if (t == "ranked_and" && wand_data_filename) {
-            op_profile(index, ranked_and_query(wdata, 10), queries);
+            op_profile(index, ranked_and_query(wdata, k), queries);
         } else if (t == "wand" && wand_data_filename) {
-            op_profile(index, wand_query(wdata, 10), queries);
+            op_profile(index, wand_query(wdata, k), queries);
         } else if (t == "maxscore" && wand_data_filename) {
-            op_profile(index, maxscore_query(wdata, 10), queries);
+            op_profile(index, maxscore_query(wdata, k), queries);
         } else {
             logger() << "Unsupported query type: " << t << std::endl;
         }
@@ -103,6 +104,10 @@ int main(int argc, const char** argv)
     if (argc > 4) {
         wand_data_filename = argv[4];
     }
+    uint64_t k = 10;
+    if (argc > 5) {
+        k = boost::lexical_cast<uint64_t>(argv[5]);
+    }
 
     std::vector<term_id_vec> queries;
     term_id_vec q;
@@ -113,7 +118,7 @@ int main(int argc, const char** argv)
         } else if (type == BOOST_PP_STRINGIZE(T)) {             \
             profile<BOOST_PP_CAT(T, _index)>                    \
                 (index_filename, wand_data_filename, queries,   \
-                 type, query_type);                             \
+                 type, query_type, k);                          \
             /**/
 
         BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_INDEX_TYPES);
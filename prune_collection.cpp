@@ -0,0 +1,70 @@
+#include <fstream>
+#include <iostream>
+
+#include <boost/lexical_cast.hpp>
+
+#include <succinct/mapper.hpp>
+
+#include "binary_freq_collection.hpp"
+#include "collection_pruning.hpp"
+#include "wand_data.hpp"
+#include "util.hpp"
+
+int main(int argc, const char** argv)
+{
+    using namespace ds2i;
+
+    if (argc < 6) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <collection basename> <wand data> <output basename>"
+                  << " <method> <parameter> [<k>]" << std::endl
+                  << "Methods: term, document, topk (see collection_pruning.hpp)"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string input_basename = argv[1];
+    const char* wand_data_filename = argv[2];
+    std::string output_basename = argv[3];
+    pruning_params params;
+    params.method = argv[4];
+    params.param = boost::lexical_cast<double>(argv[5]);
+    if (argc > 6) {
+        params.k = boost::lexical_cast<uint64_t>(argv[6]);
+    }
+
+    binary_freq_collection coll(input_basename.c_str());
+    wand_data<> wdata;
+    boost::iostreams::mapped_file_source md(wand_data_filename);
+    succinct::mapper::map(wdata, md, succinct::mapper::map_flags::warmup);
+
+    logger() << "Pruning " << input_basename << " with method "
+             << params.method << ", parameter " << params.param << std::endl;
+    collection_pruner<wand_data<>> pruner(coll, wdata, params);
+    auto stats = pruner.write(output_basename);
+
+    // the document sizes are unchanged, so that the wand data of the
+    // pruned collection can be built as usual
+    {
+        std::ifstream sizes_in((input_basename + ".sizes").c_str(), std::ios::binary);
+        if (sizes_in) {
+            std::ofstream sizes_out((output_basename + ".sizes").c_str(),
+                                    std::ios::binary);
+            sizes_out << sizes_in.rdbuf();
+        }
+    }
+
+    double ratio = double(stats.kept_postings) / stats.postings;
+    logger() << "Kept " << stats.kept_postings << " postings out of "
+             << stats.postings << " (" << 100 * ratio << "%)" << std::endl;
+
+    stats_line()
+        ("method", params.method)
+        ("param", params.param)
+        ("k", params.k)
+        ("lists", stats.lists)
+        ("postings", stats.postings)
+        ("kept_postings", stats.kept_postings)
+        ("kept_ratio", ratio)
+        ;
+}
@@ -3,19 +3,26 @@
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 
+#include <boost/lexical_cast.hpp>
+
 #include <succinct/mapper.hpp>
 
+#include "binary_collection.hpp"
 #include "index_types.hpp"
 #include "wand_data.hpp"
+#include "multi_field_wand_data.hpp"
 #include "queries.hpp"
 #include "util.hpp"
 
-template <typename QueryOperator, typename IndexType>
+template <typename QueryOperator, typename IndexType, typename Filter>
 void op_perftest(IndexType const& index,
                  QueryOperator&& query_op, // XXX!!!
                  std::vector<ds2i::term_id_vec> const& queries,
                  std::string const& index_type,
                  std::string const& query_type,
+                 uint64_t k,
+                 ds2i::docid_range const& range,
+                 Filter const& filter,
                  size_t runs)
 {
     using namespace ds2i;
@@ -25,7 +32,7 @@ void op_perftest(IndexType const& index,
     for (size_t run = 0; run <= runs; ++run) {
         for (auto const& query: queries) {
             auto tick = get_time_usecs();
-            uint64_t result = query_op(index, query);
+            uint64_t result = query_op(index, query, range, filter);
             do_not_optimize_away(result);
             double elapsed = double(get_time_usecs() - tick);
             if (run != 0) { // first run is not timed
@@ -53,6 +60,9 @@ void op_perftest(IndexType const& index,
         stats_line()
             ("type", index_type)
             ("query", query_type)
+            ("k", k)
+            ("range_begin", range.begin)
+            ("range_end", range.end_in(index.num_docs()))
             ("avg", avg)
             ("q50", q50)
             ("q90", q90)
@@ -62,12 +72,176 @@ void op_perftest(IndexType const& index,
 }
 
 
-template <typename IndexType>
+// Measures the recall of approximate WAND or maxscore, that is the fraction
+// of the exact top-k that they return, and their latency, for a sweep of
+// threshold factors
+template <typename QueryOperator, typename IndexType, typename WandType,
+          typename Filter>
+void recall_perftest(IndexType const& index, WandType const& wdata,
+                     std::vector<ds2i::term_id_vec> const& queries,
+                     std::string const& index_type,
+                     std::string const& query_type,
+                     uint64_t k,
+                     ds2i::docid_range const& range,
+                     Filter const& filter)
+{
+    using namespace ds2i;
+
+    std::vector<std::vector<uint64_t>> exact(queries.size());
+    QueryOperator exact_op(wdata, k, 1);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        exact_op(index, queries[i], range, filter);
+        for (auto const& entry: exact_op.topk()) {
+            exact[i].push_back(entry.second);
+        }
+        std::sort(exact[i].begin(), exact[i].end());
+    }
+
+    static const float factors[] = {1, 1.05, 1.1, 1.2, 1.3, 1.5, 2, 3};
+    for (float factor: factors) {
+        QueryOperator query_op(wdata, k, factor);
+        double recall_sum = 0;
+        size_t nonempty = 0;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            if (exact[i].empty()) continue;
+            query_op(index, queries[i], range, filter);
+            size_t found = 0;
+            for (auto const& entry: query_op.topk()) {
+                found += std::binary_search(exact[i].begin(), exact[i].end(),
+                                            entry.second);
+            }
+            recall_sum += double(found) / exact[i].size();
+            nonempty += 1;
+        }
+        double recall = nonempty ? recall_sum / nonempty : 1;
+
+        logger() << "Threshold factor " << factor << ", recall: "
+                 << recall << std::endl;
+        stats_line()
+            ("type", index_type)
+            ("query", query_type)
+            ("k", k)
+            ("threshold_factor", factor)
+            ("recall", recall)
+            ;
+        std::ostringstream name;
+        name << query_type << "@" << factor;
+        op_perftest(index, query_op, queries, index_type, name.str(),
+                    k, range, filter, 2);
+    }
+}
+
+// The static scores are read from the file in DS2I_STATIC_SCORES, in the
+// same format as the document sizes, and normalized to [0, 1]; if it is
+// not set the docids are assumed to be sorted by static rank, with linearly
+// decreasing scores
+std::vector<float> read_static_scores(uint64_t num_docs)
+{
+    using namespace ds2i;
+    std::vector<float> static_scores(num_docs);
+    std::string const& filename = configuration::get().static_scores;
+    if (filename.empty()) {
+        for (uint64_t i = 0; i < num_docs; ++i) {
+            static_scores[i] = 1 - float(i) / num_docs;
+        }
+        return static_scores;
+    }
+
+    logger() << "Loading static scores from " << filename << std::endl;
+    binary_collection coll(filename.c_str());
+    auto seq = *coll.begin();
+    if (seq.size() != num_docs) {
+        throw std::invalid_argument("Static scores do not match the collection");
+    }
+    float max_score = std::max<float>(1, *std::max_element(seq.begin(), seq.end()));
+    for (uint64_t i = 0; i < num_docs; ++i) {
+        static_scores[i] = seq.begin()[i] / max_score;
+    }
+    return static_scores;
+}
+
+// The docid filter is read from a file in the same format as the
+// document sizes, holding a single sequence of docids, which are allowed
+// or, with deny, excluded
+void read_filter(std::string const& filename, uint64_t num_docs, bool deny,
+                 ds2i::bitmap_filter& filter)
+{
+    using namespace ds2i;
+    logger() << "Loading " << (deny ? "denied" : "allowed")
+             << " docids from " << filename << std::endl;
+    binary_collection coll(filename.c_str());
+    auto seq = *coll.begin();
+    bitmap_filter(num_docs, seq.begin(), seq.end(), deny).swap(filter);
+}
+
+template <typename IndexType, typename WandType, typename Filter>
+void run_queries(IndexType const& index,
+                 WandType const& wdata,
+                 bool has_wand,
+                 std::vector<ds2i::term_id_vec> const& queries,
+                 std::string const& type,
+                 std::string const& query_type,
+                 uint64_t k,
+                 ds2i::docid_range const& range,
+                 Filter const& filter)
+{
+    using namespace ds2i;
+
+    std::vector<std::string> query_types;
+    boost::algorithm::split(query_types, query_type, boost::is_any_of(":"));
+
+    logger() << "Performing " << type << " queries" << std::endl;
+    for (auto const& t: query_types) {
+        logger() << "Query type: " << t << std::endl;
+
+        if (t == "and") {
+            op_perftest(index, and_query<false>(), queries, type, t, k, range, filter, 2);
+        } else if (t == "and_freq") {
+            op_perftest(index, and_query<true>(), queries, type, t, k, range, filter, 2);
+        } else if (t == "or") {
+            op_perftest(index, or_query<false>(), queries, type, t, k, range, filter, 2);
+        } else if (t == "or_freq") {
+            op_perftest(index, or_query<true>(), queries, type, t, k, range, filter, 2);
+        } else if (t == "wand" && has_wand) {
+            op_perftest(index, basic_wand_query<WandType>(wdata, k),
+                        queries, type, t, k, range, filter, 2);
+        } else if (t == "ranked_or" && has_wand) {
+            op_perftest(index, basic_ranked_or_query<WandType>(wdata, k),
+                        queries, type, t, k, range, filter, 2);
+        } else if (t == "ranked_and" && has_wand) {
+            op_perftest(index, basic_ranked_and_query<WandType>(wdata, k),
+                        queries, type, t, k, range, filter, 2);
+        } else if (t == "maxscore" && has_wand) {
+            op_perftest(index, basic_maxscore_query<WandType>(wdata, k),
+                        queries, type, t, k, range, filter, 2);
+        } else if (t == "wand_recall" && has_wand) {
+            recall_perftest<basic_wand_query<WandType>>
+                (index, wdata, queries, type, t, k, range, filter);
+        } else if (t == "maxscore_recall" && has_wand) {
+            recall_perftest<basic_maxscore_query<WandType>>
+                (index, wdata, queries, type, t, k, range, filter);
+        } else if (t == "static_rank_and" && has_wand) {
+            auto static_scores = read_static_scores(index.num_docs());
+            op_perftest(index, basic_static_rank_and_query<WandType>
+                        (wdata, k, static_scores,
+                         configuration::get().static_weight),
+                        queries, type, t, k, range, filter, 2);
+        } else {
+            logger() << "Unsupported query type: " << t << std::endl;
+        }
+    }
+}
+
+template <typename IndexType, typename WandType>
 void perftest(const char* index_filename,
               const char* wand_data_filename,
               std::vector<ds2i::term_id_vec> const& queries,
               std::string const& type,
-              std::string const& query_type)
+              std::string const& query_type,
+              uint64_t k,
+              ds2i::docid_range const& range,
+              std::string const& filter_filename,
+              bool deny)
 {
     using namespace ds2i;
 
@@ -87,37 +261,22 @@ void perftest(const char* index_filename,
         }
     }
 
-    wand_data<> wdata;
+    WandType wdata;
     boost::iostreams::mapped_file_source md;
     if (wand_data_filename) {
         md.open(wand_data_filename);
         succinct::mapper::map(wdata, md, succinct::mapper::map_flags::warmup);
     }
 
-    std::vector<std::string> query_types;
-    boost::algorithm::split(query_types, query_type, boost::is_any_of(":"));
-
-    logger() << "Performing " << type << " queries" << std::endl;
-    for (auto const& t: query_types) {
-        logger() << "Query type: " << t << std::endl;
-
-        if (t == "and") {
-            op_perftest(index, and_query<false>(), queries, type, t, 2);
-        } else if (t == "and_freq") {
-            op_perftest(index, and_query<true>(), queries, type, t, 2);
-        } else if (t == "or") {
-            op_perftest(index, or_query<false>(), queries, type, t, 2);
-        } else if (t == "or_freq") {
-            op_perftest(index, or_query<true>(), queries, type, t, 2);
-        } else if (t == "wand" && wand_data_filename) {
-            op_perftest(index, wand_query(wdata, 10), queries, type, t, 2);
-        } else if (t == "ranked_and" && wand_data_filename) {
-            op_perftest(index, ranked_and_query(wdata, 10), queries, type, t, 2);
-        } else if (t == "maxscore" && wand_data_filename) {
-            op_perftest(index, maxscore_query(wdata, 10), queries, type, t, 2);
-        } else {
-            logger() << "Unsupported query type: " << t << std::endl;
-        }
+    bool has_wand = wand_data_filename != nullptr;
+    if (filter_filename.empty()) {
+        run_queries(index, wdata, has_wand, queries, type, query_type,
+                    k, range, no_filter());
+    } else {
+        bitmap_filter filter;
+        read_filter(filter_filename, index.num_docs(), deny, filter);
+        run_queries(index, wdata, has_wand, queries, type, query_type,
+                    k, range, filter);
     }
 }
 
@@ -132,6 +291,42 @@ int main(int argc, const char** argv)
     if (argc > 4) {
         wand_data_filename = argv[4];
     }
+    uint64_t k = 10;
+    if (argc > 5) {
+        k = boost::lexical_cast<uint64_t>(argv[5]);
+    }
+    // restricts the queries to the docids in [begin, end)
+    docid_range range;
+    if (argc > 6) {
+        std::vector<std::string> bounds;
+        std::string range_arg = argv[6];
+        boost::algorithm::split(bounds, range_arg, boost::is_any_of(":"));
+        if (bounds.size() != 2) {
+            logger() << "ERROR: Invalid docid range " << range_arg
+                     << ", expected <begin>:<end>" << std::endl;
+            return 1;
+        }
+        range.begin = boost::lexical_cast<uint64_t>(bounds[0]);
+        if (!bounds[1].empty()) {
+            range.end = boost::lexical_cast<uint64_t>(bounds[1]);
+        }
+    }
+    // restricts the queries to the docids listed in a file (allow:<file>),
+    // or to the docids not listed (deny:<file>)
+    std::string filter_filename;
+    bool deny = false;
+    if (argc > 7) {
+        std::string filter_arg = argv[7];
+        size_t colon = filter_arg.find(':');
+        std::string mode = filter_arg.substr(0, colon);
+        if (colon == std::string::npos || (mode != "allow" && mode != "deny")) {
+            logger() << "ERROR: Invalid docid filter " << filter_arg
+                     << ", expected allow:<file> or deny:<file>" << std::endl;
+            return 1;
+        }
+        filter_filename = filter_arg.substr(colon + 1);
+        deny = mode == "deny";
+    }
 
     std::vector<term_id_vec> queries;
     term_id_vec q;
@@ -140,11 +335,16 @@ int main(int argc, const char** argv)
     if (false) {
 #define LOOP_BODY(R, DATA, T)                                   \
         } else if (type == BOOST_PP_STRINGIZE(T)) {             \
-            perftest<BOOST_PP_CAT(T, _index)>                   \
-                (index_filename, wand_data_filename, queries, type, query_type); \
+            perftest<BOOST_PP_CAT(T, _index), DATA>             \
+                (index_filename, wand_data_filename, queries, type, query_type, k, range, \
+                 filter_filename, deny);                        \
             /**/
 
-        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_INDEX_TYPES);
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, wand_data<>, DS2I_INDEX_TYPES);
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, wand_data<>, DS2I_TWO_TIER_INDEX_TYPES);
+        // multi-field indexes are scored with BM25F
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, multi_field_wand_data<>,
+                              DS2I_MULTI_FIELD_INDEX_TYPES);
 #undef LOOP_BODY
     } else {
         logger() << "ERROR: Unknown type " << type << std::endl;
@@ -2,9 +2,15 @@
 
 #include <iostream>
 #include <sstream>
+#include <limits>
+#include <type_traits>
 
+#include <succinct/broadword.hpp>
+
+#include "configuration.hpp"
 #include "index_types.hpp"
 #include "wand_data.hpp"
+#include "docid_filter.hpp"
 #include "util.hpp"
 
 namespace ds2i {
@@ -32,13 +38,47 @@ namespace ds2i {
         terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
     }
 
+    // Restricts a query to the documents in [begin, end): the enumerators
+    // are moved to begin with a next_geq, and the operators stop at end,
+    // so the cost is proportional to the postings in the range. The
+    // ranked operators still weight the terms by their global frequency,
+    // so the scores are the same as in the unrestricted query.
+    struct docid_range {
+        docid_range(uint64_t begin = 0,
+                    uint64_t end = std::numeric_limits<uint64_t>::max())
+            : begin(begin)
+            , end(end)
+        {}
+
+        template <typename Enum>
+        void skip_to_begin(Enum& e) const
+        {
+            if (begin) e.next_geq(begin);
+        }
+
+        uint64_t end_in(uint64_t num_docs) const
+        {
+            return std::min(end, num_docs);
+        }
+
+        bool empty_in(uint64_t num_docs) const
+        {
+            return begin >= end_in(num_docs);
+        }
+
+        uint64_t begin;
+        uint64_t end;
+    };
+
     template <bool with_freqs>
     struct and_query {
 
-        template <typename Index>
-        uint64_t operator()(Index const& index, term_id_vec terms) const
+        template <typename Index, typename Filter = no_filter>
+        uint64_t operator()(Index const& index, term_id_vec terms,
+                            docid_range const& range = docid_range(),
+                            Filter const& filter = Filter()) const
         {
-            if (terms.empty()) return 0;
+            if (terms.empty() || range.empty_in(index.num_docs())) return 0;
             remove_duplicate_terms(terms);
 
             typedef typename Index::document_enumerator enum_type;
@@ -56,9 +96,12 @@ namespace ds2i {
                       });
 
             uint64_t results = 0;
+            uint64_t end = range.end_in(index.num_docs());
+            auto filter_cursor = filter.get_cursor();
+            range.skip_to_begin(enums[0]);
             uint64_t candidate = enums[0].docid();
             size_t i = 1;
-            while (candidate < index.num_docs()) {
+            while (candidate < end) {
                 for (; i < enums.size(); ++i) {
                     enums[i].next_geq(candidate);
                     if (enums[i].docid() != candidate) {
@@ -68,7 +111,14 @@ namespace ds2i {
                     }
                 }
 
+                // the filter is the last list to intersect
                 if (i == enums.size()) {
+                    uint64_t allowed = filter_cursor.next_geq(candidate);
+                    if (allowed != candidate) {
+                        candidate = allowed;
+                        i = 0;
+                        continue;
+                    }
                     results += 1;
                     if (with_freqs) {
                         for (i = 0; i < enums.size(); ++i) {
@@ -83,15 +133,243 @@ namespace ds2i {
 
             return results;
         }
+
+        // The lists with a bitmap are not decoded: the candidates of the
+        // intersection of the other lists are checked with bit tests, and
+        // when all the lists have a bitmap they are intersected a chunk
+        // of words at a time
+        template <typename BaseIndex, typename Filter = no_filter>
+        uint64_t operator()(bitmap_lists_index<BaseIndex> const& index,
+                            term_id_vec terms,
+                            docid_range const& range = docid_range(),
+                            Filter const& filter = Filter()) const
+        {
+            if (terms.empty() || range.empty_in(index.num_docs())) return 0;
+            remove_duplicate_terms(terms);
+
+            typedef typename bitmap_lists_index<BaseIndex>::document_enumerator enum_type;
+            std::vector<enum_type> enums;
+            std::vector<enum_type> bitmap_enums;
+
+            for (auto term: terms) {
+                auto e = index[term];
+                if (e.has_bitmap()) {
+                    bitmap_enums.push_back(e);
+                } else {
+                    enums.push_back(e);
+                }
+            }
+
+            // sort by increasing frequency
+            auto by_size = [](enum_type const& lhs, enum_type const& rhs) {
+                return lhs.size() < rhs.size();
+            };
+            std::sort(enums.begin(), enums.end(), by_size);
+            std::sort(bitmap_enums.begin(), bitmap_enums.end(), by_size);
+
+            uint64_t results = 0;
+            uint64_t end = range.end_in(index.num_docs());
+            auto filter_cursor = filter.get_cursor();
+            bool filtered = !std::is_same<Filter, no_filter>::value;
+            auto bitmap_freqs = [&](uint64_t docid) {
+                for (auto& e: bitmap_enums) {
+                    e.next_geq(docid);
+                    do_not_optimize_away(e.freq());
+                }
+            };
+
+            if (enums.empty()) {
+                static const uint64_t chunk_words = 512;
+                uint64_t chunk[chunk_words];
+                uint64_t first_word = range.begin / 64;
+                uint64_t words = (end + 63) / 64;
+                for (uint64_t begin = first_word; begin < words; begin += chunk_words) {
+                    uint64_t n = std::min(chunk_words, words - begin);
+                    uint64_t const* first = bitmap_enums[0].bitmap() + begin;
+                    std::copy(first, first + n, chunk);
+                    for (size_t i = 1; i < bitmap_enums.size(); ++i) {
+                        uint64_t const* bitmap = bitmap_enums[i].bitmap() + begin;
+                        for (uint64_t w = 0; w < n; ++w) {
+                            chunk[w] &= bitmap[w];
+                        }
+                    }
+                    // clear the docids outside of the range
+                    if (begin == first_word) {
+                        chunk[0] &= uint64_t(-1) << (range.begin % 64);
+                    }
+                    if (begin + n == words && end % 64) {
+                        chunk[n - 1] &= (uint64_t(1) << (end % 64)) - 1;
+                    }
+
+                    for (uint64_t w = 0; w < n; ++w) {
+                        if (with_freqs || filtered) {
+                            uint64_t word = chunk[w];
+                            unsigned long bit;
+                            while (succinct::broadword::lsb(word, bit)) {
+                                uint64_t docid = (begin + w) * 64 + bit;
+                                word &= word - 1;
+                                if (filter_cursor.next_geq(docid) != docid) continue;
+                                results += 1;
+                                if (with_freqs) bitmap_freqs(docid);
+                            }
+                        } else {
+                            results += succinct::broadword::popcount(chunk[w]);
+                        }
+                    }
+                }
+                return results;
+            }
+
+            range.skip_to_begin(enums[0]);
+            uint64_t candidate = enums[0].docid();
+            size_t i = 1;
+            while (candidate < end) {
+                for (; i < enums.size(); ++i) {
+                    enums[i].next_geq(candidate);
+                    if (enums[i].docid() != candidate) {
+                        candidate = enums[i].docid();
+                        i = 0;
+                        break;
+                    }
+                }
+
+                if (i == enums.size()) {
+                    uint64_t allowed = filter_cursor.next_geq(candidate);
+                    if (allowed != candidate) {
+                        candidate = allowed;
+                        i = 0;
+                        continue;
+                    }
+                    bool match = true;
+                    for (auto const& e: bitmap_enums) {
+                        if (!e.contains(candidate)) {
+                            match = false;
+                            break;
+                        }
+                    }
+                    if (match) {
+                        results += 1;
+                        if (with_freqs) {
+                            for (i = 0; i < enums.size(); ++i) {
+                                do_not_optimize_away(enums[i].freq());
+                            }
+                            bitmap_freqs(candidate);
+                        }
+                    }
+                    enums[0].next();
+                    candidate = enums[0].docid();
+                    i = 1;
+                }
+            }
+
+            return results;
+        }
     };
 
+    // Min-heap of the enumerators of a disjunction by current docid. The
+    // OR operators use it on queries with at least DS2I_HEAP_OR_THRESHOLD
+    // terms, in place of scanning all the enumerators at each document:
+    // a posting then costs a sift-down, logarithmic in the number of
+    // terms. GetDocid maps an element to the docid of its enumerator.
+    template <typename T, typename GetDocid>
+    class docid_heap {
+    public:
+        docid_heap(std::vector<T*> elements)
+            : m_heap(std::move(elements))
+        {
+            std::make_heap(m_heap.begin(), m_heap.end(),
+                           [](T const* lhs, T const* rhs) {
+                               return GetDocid()(lhs) > GetDocid()(rhs);
+                           });
+        }
+
+        T* top() const
+        {
+            return m_heap.front();
+        }
+
+        uint64_t top_docid() const
+        {
+            return GetDocid()(m_heap.front());
+        }
+
+        // Restores the heap after the top enumerator has been advanced
+        void update_top()
+        {
+            size_t n = m_heap.size();
+            T* elem = m_heap.front();
+            uint64_t docid = GetDocid()(elem);
+            size_t i = 0;
+            while (true) {
+                size_t child = 2 * i + 1;
+                if (child >= n) break;
+                uint64_t child_docid = GetDocid()(m_heap[child]);
+                if (child + 1 < n) {
+                    uint64_t right_docid = GetDocid()(m_heap[child + 1]);
+                    if (right_docid < child_docid) {
+                        child += 1;
+                        child_docid = right_docid;
+                    }
+                }
+                if (docid <= child_docid) break;
+                m_heap[i] = m_heap[child];
+                i = child;
+            }
+            m_heap[i] = elem;
+        }
+
+    private:
+        std::vector<T*> m_heap;
+    };
+
+    struct enum_docid {
+        template <typename Enum>
+        uint64_t operator()(Enum const* e) const
+        {
+            return e->docid();
+        }
+    };
+
+    struct scored_enum_docid {
+        template <typename ScoredEnum>
+        uint64_t operator()(ScoredEnum const* e) const
+        {
+            return e->docs_enum.docid();
+        }
+    };
+
+    // Moves the enumerators in [begin, end) that are behind lower_bound
+    // to the next docid greater than or equal to it, and returns the
+    // smallest current docid; GetEnum maps an element of the range to
+    // its document enumerator
+    template <typename Iterator, typename GetEnum>
+    uint64_t skip_to(Iterator begin, Iterator end, uint64_t lower_bound,
+                     uint64_t num_docs, GetEnum get_enum)
+    {
+        uint64_t min_doc = num_docs;
+        for (; begin != end; ++begin) {
+            auto& e = get_enum(*begin);
+            if (e.docid() < lower_bound) {
+                e.next_geq(lower_bound);
+            }
+            min_doc = std::min<uint64_t>(min_doc, e.docid());
+        }
+        return min_doc;
+    }
+
     template <bool with_freqs>
     struct or_query {
 
-        template <typename Index>
-        uint64_t operator()(Index const& index, term_id_vec terms) const
+        or_query(size_t heap_threshold = configuration::get().heap_or_threshold)
+            : m_heap_threshold(heap_threshold)
+        {}
+
+        template <typename Index, typename Filter = no_filter>
+        uint64_t operator()(Index const& index, term_id_vec terms,
+                            docid_range const& range = docid_range(),
+                            Filter const& filter = Filter()) const
         {
-            if (terms.empty()) return 0;
+            if (terms.empty() || range.empty_in(index.num_docs())) return 0;
             remove_duplicate_terms(terms);
 
             typedef typename Index::document_enumerator enum_type;
@@ -100,15 +378,59 @@ namespace ds2i {
 
             for (auto term: terms) {
                 enums.push_back(index[term]);
+                range.skip_to_begin(enums.back());
             }
 
             uint64_t results = 0;
+            uint64_t end = range.end_in(index.num_docs());
+            auto filter_cursor = filter.get_cursor();
+            if (enums.size() >= m_heap_threshold) {
+                std::vector<enum_type*> ptrs;
+                for (auto& e: enums) ptrs.push_back(&e);
+                docid_heap<enum_type, enum_docid> heap(std::move(ptrs));
+
+                uint64_t cur_doc = heap.top_docid();
+                while (cur_doc < end) {
+                    uint64_t allowed = filter_cursor.next_geq(cur_doc);
+                    if (allowed != cur_doc) {
+                        // skip the docids that are filtered out
+                        if (allowed >= end) break;
+                        do {
+                            heap.top()->next_geq(allowed);
+                            heap.update_top();
+                        } while (heap.top_docid() < allowed);
+                        cur_doc = heap.top_docid();
+                        continue;
+                    }
+
+                    results += 1;
+                    do {
+                        if (with_freqs) {
+                            do_not_optimize_away(heap.top()->freq());
+                        }
+                        heap.top()->next();
+                        heap.update_top();
+                    } while (heap.top_docid() == cur_doc);
+                    cur_doc = heap.top_docid();
+                }
+                return results;
+            }
+
             uint64_t cur_doc = std::min_element(enums.begin(), enums.end(),
                                                 [](enum_type const& lhs, enum_type const& rhs) {
                                                     return lhs.docid() < rhs.docid();
                                                 })->docid();
 
-            while (cur_doc < index.num_docs()) {
+            while (cur_doc < end) {
+                uint64_t allowed = filter_cursor.next_geq(cur_doc);
+                if (allowed != cur_doc) {
+                    if (allowed >= end) break;
+                    cur_doc = skip_to(enums.begin(), enums.end(), allowed,
+                                      index.num_docs(),
+                                      [](enum_type& e) -> enum_type& { return e; });
+                    continue;
+                }
+
                 results += 1;
                 uint64_t next_doc = index.num_docs();
                 for (size_t i = 0; i < enums.size(); ++i) {
@@ -128,6 +450,9 @@ namespace ds2i {
 
             return results;
         }
+
+    private:
+        size_t m_heap_threshold;
     };
 
     typedef std::pair<uint64_t, uint64_t> term_freq_pair;
@@ -149,22 +474,45 @@ namespace ds2i {
         return query_term_freqs;
     }
 
+    // Keeps the k entries with highest score. For small k they are kept in
+    // a min-heap; from buffered_threshold on, the pop/push pair on a large
+    // heap at each insertion is too expensive, so the entries are appended
+    // to a buffer that is cut down to the best k with nth_element when it
+    // reaches 2k entries. Insertions are then amortized constant time, and
+    // would_enter compares with the k-th score at the last cut, a lower
+    // bound of the current one.
     struct topk_queue {
+        typedef std::pair<float, uint64_t> entry_type; // (score, docid)
+
+        static const uint64_t buffered_threshold = 1024;
+
         topk_queue(uint64_t k)
             : m_k(k)
+            , m_buffered(k >= buffered_threshold)
+            , m_threshold(0)
         {}
 
-        bool insert(float score)
+        bool insert(float score, uint64_t docid)
         {
+            if (m_buffered) {
+                if (!would_enter(score)) return false;
+                m_q.emplace_back(score, docid);
+                // the threshold is set as soon as there are k entries
+                if (m_q.size() == m_k || m_q.size() == 2 * m_k) {
+                    cut();
+                }
+                return true;
+            }
+
             if (m_q.size() < m_k) {
-                m_q.push_back(score);
-                std::push_heap(m_q.begin(), m_q.end(), std::greater<float>());
+                m_q.emplace_back(score, docid);
+                std::push_heap(m_q.begin(), m_q.end(), min_heap_order);
                 return true;
             } else {
-                if (score > m_q.front()) {
-                    std::pop_heap(m_q.begin(), m_q.end(), std::greater<float>());
-                    m_q.back() = score;
-                    std::push_heap(m_q.begin(), m_q.end(), std::greater<float>());
+                if (score > m_q.front().first) {
+                    std::pop_heap(m_q.begin(), m_q.end(), min_heap_order);
+                    m_q.back() = entry_type(score, docid);
+                    std::push_heap(m_q.begin(), m_q.end(), min_heap_order);
                     return true;
                 }
             }
@@ -173,15 +521,23 @@ namespace ds2i {
 
         bool would_enter(float score) const
         {
-            return m_q.size() < m_k || score > m_q.front();
+            if (m_buffered) {
+                return m_q.size() < m_k || score > m_threshold;
+            }
+            return m_q.size() < m_k || score > m_q.front().first;
         }
 
         void finalize()
         {
-            std::sort_heap(m_q.begin(), m_q.end(), std::greater<float>());
+            if (m_buffered) {
+                if (m_q.size() > m_k) cut();
+                std::sort(m_q.begin(), m_q.end(), min_heap_order);
+                return;
+            }
+            std::sort_heap(m_q.begin(), m_q.end(), min_heap_order);
         }
 
-        std::vector<float> const& topk() const
+        std::vector<entry_type> const& topk() const
         {
             return m_q;
         }
@@ -189,32 +545,104 @@ namespace ds2i {
         void clear()
         {
             m_q.clear();
+            m_threshold = 0;
         }
 
     private:
+        static bool min_heap_order(entry_type const& lhs, entry_type const& rhs)
+        {
+            return lhs.first > rhs.first;
+        }
+
+        // keeps the best k entries, and their minimum score as threshold
+        void cut()
+        {
+            auto kth = m_q.begin() + (m_k - 1);
+            std::nth_element(m_q.begin(), kth, m_q.end(), min_heap_order);
+            m_threshold = kth->first;
+            m_q.resize(m_k);
+        }
+
         uint64_t m_k;
-        std::vector<float> m_q;
+        bool m_buffered;
+        float m_threshold;
+        std::vector<entry_type> m_q;
     };
 
 
-    struct wand_query {
+    // WAND and maxscore prune with the top-k threshold multiplied by
+    // threshold_factor (DS2I_THRESHOLD_FACTOR, 1 by default): with a
+    // factor greater than 1 the pruning is more aggressive, and the
+    // top-k is approximate.
+    inline float check_threshold_factor(float threshold_factor)
+    {
+        if (!(threshold_factor >= 1)) {
+            throw std::invalid_argument("Threshold factor must be at least 1");
+        }
+        return threshold_factor;
+    }
 
-        typedef bm25 scorer_type;
+    // WAND and maxscore traverse the tiers of a list as separate lists,
+    // each with its own max weight; only the lists of a two_tier_index
+    // can have more than one tier. A second cursor pays off only if the
+    // low tier can be skipped well before the whole term, so the builder
+    // splits only the lists whose low tier weighs at most
+    // max_low_tier_ratio() times the term; the check is repeated here
+    // since the max weight of the term comes from the wand data.
+    template <typename Index, typename Enum, typename ScoredEnums>
+    void push_tiers(Index const&, Enum&& list, float q_weight,
+                    float max_weight, ScoredEnums& enums)
+    {
+        typedef typename ScoredEnums::value_type scored_enum;
+        enums.push_back(scored_enum {std::move(list), q_weight, max_weight});
+    }
 
-        wand_query(wand_data<scorer_type> const& wdata, uint64_t k)
+    template <typename BaseIndex, typename Enum, typename ScoredEnums>
+    void push_tiers(two_tier_index<BaseIndex> const&, Enum&& list, float q_weight,
+                    float max_weight, ScoredEnums& enums)
+    {
+        typedef typename ScoredEnums::value_type scored_enum;
+        float max_low_weight = two_tier_index<BaseIndex>::max_low_tier_ratio()
+            * max_weight;
+        float low_max_weight = q_weight * list.low_max_weight();
+        if (!list.is_split() || low_max_weight > max_low_weight) {
+            enums.push_back(scored_enum {std::move(list), q_weight, max_weight});
+            return;
+        }
+        // the max weight of the term is the max weight of the high tier
+        enums.push_back(scored_enum {list.high_tier(), q_weight, max_weight});
+        enums.push_back(scored_enum {list.low_tier(), q_weight, low_max_weight});
+    }
+
+    // The ranked operators are parametrized on the scoring data, which
+    // provides the scorer type, the max term weights, and the weight of
+    // the posting of a document given its doc_norms(): wand_data for
+    // BM25, multi_field_wand_data for BM25F on a multi_field_index.
+    template <typename WandData>
+    struct basic_wand_query {
+
+        typedef typename WandData::scorer_type scorer_type;
+
+        basic_wand_query(WandData const& wdata, uint64_t k,
+                         float threshold_factor =
+                         configuration::get().threshold_factor)
             : m_wdata(&wdata)
             , m_topk(k)
+            , m_threshold_factor(check_threshold_factor(threshold_factor))
         {}
 
-        template <typename Index>
-        uint64_t operator()(Index const& index, term_id_vec const& terms)
+        template <typename Index, typename Filter = no_filter>
+        uint64_t operator()(Index const& index, term_id_vec const& terms,
+                            docid_range const& range = docid_range(),
+                            Filter const& filter = Filter())
         {
             m_topk.clear();
-            if (terms.empty()) return 0;
+            if (terms.empty() || range.empty_in(index.num_docs())) return 0;
 
             auto query_term_freqs = query_freqs(terms);
 
             uint64_t num_docs = index.num_docs();
+            uint64_t end = range.end_in(num_docs);
             typedef typename Index::document_enumerator enum_type;
             struct scored_enum {
                 enum_type docs_enum;
@@ -230,13 +658,18 @@ namespace ds2i {
                 auto q_weight = scorer_type::query_term_weight
                     (term.second, list.size(), num_docs);
                 auto max_weight = q_weight * m_wdata->max_term_weight(term.first);
-                enums.push_back(scored_enum {std::move(list), q_weight, max_weight});
+                range.skip_to_begin(list);
+                push_tiers(index, std::move(list), q_weight, max_weight, enums);
             }
 
+            // the lists with no postings in the range do not contribute
+            // to the upper bounds
             std::vector<scored_enum*> ordered_enums;
             ordered_enums.reserve(enums.size());
             for (auto& en: enums) {
-                ordered_enums.push_back(&en);
+                if (en.docs_enum.docid() < end) {
+                    ordered_enums.push_back(&en);
+                }
             }
 
             auto sort_enums = [&]() {
@@ -247,6 +680,7 @@ namespace ds2i {
                           });
             };
 
+            auto filter_cursor = filter.get_cursor();
             sort_enums();
             while (true) {
                 // find pivot
@@ -254,11 +688,11 @@ namespace ds2i {
                 size_t pivot;
                 bool found_pivot = false;
                 for (pivot = 0; pivot < ordered_enums.size(); ++pivot) {
-                    if (ordered_enums[pivot]->docs_enum.docid() == num_docs) {
+                    if (ordered_enums[pivot]->docs_enum.docid() >= end) {
                         break;
                     }
                     upper_bound += ordered_enums[pivot]->max_weight;
-                    if (m_topk.would_enter(upper_bound)) {
+                    if (m_topk.would_enter(upper_bound / m_threshold_factor)) {
                         found_pivot = true;
                         break;
                     }
@@ -269,21 +703,34 @@ namespace ds2i {
                     break;
                 }
 
-                // check if pivot is a possible match
+                // the documents up to the next allowed one cannot match
                 uint64_t pivot_id = ordered_enums[pivot]->docs_enum.docid();
+                uint64_t allowed = filter_cursor.next_geq(pivot_id);
+                if (allowed != pivot_id) {
+                    if (allowed >= end) break;
+                    skip_to(ordered_enums.begin(), ordered_enums.end(), allowed,
+                            num_docs,
+                            [](scored_enum* en) -> enum_type& {
+                                return en->docs_enum;
+                            });
+                    sort_enums();
+                    continue;
+                }
+
+                // check if pivot is a possible match
                 if (pivot_id == ordered_enums[0]->docs_enum.docid()) {
                     float score = 0;
-                    float norm_len = m_wdata->norm_len(pivot_id);
+                    auto doc_norms = m_wdata->doc_norms(pivot_id);
                     for (scored_enum* en: ordered_enums) {
                         if (en->docs_enum.docid() != pivot_id) {
                             break;
                         }
-                        score += en->q_weight * scorer_type::doc_term_weight
-                            (en->docs_enum.freq(), norm_len);
+                        score += en->q_weight * m_wdata->doc_term_weight
+                            (en->docs_enum, doc_norms);
                         en->docs_enum.next();
                     }
 
-                    m_topk.insert(score);
+                    m_topk.insert(score, pivot_id);
                     // resort by docid
                     sort_enums();
                 } else {
@@ -308,31 +755,37 @@ namespace ds2i {
             return m_topk.topk().size();
         }
 
-        std::vector<float> const& topk() const
+        std::vector<topk_queue::entry_type> const& topk() const
         {
             return m_topk.topk();
         }
 
     private:
-        wand_data<scorer_type> const* m_wdata;
+        WandData const* m_wdata;
         topk_queue m_topk;
+        float m_threshold_factor;
     };
 
+    typedef basic_wand_query<wand_data<>> wand_query;
+
 
-    struct ranked_and_query {
+    template <typename WandData>
+    struct basic_ranked_and_query {
 
-        typedef bm25 scorer_type;
+        typedef typename WandData::scorer_type scorer_type;
 
-        ranked_and_query(wand_data<scorer_type> const& wdata, uint64_t k)
+        basic_ranked_and_query(WandData const& wdata, uint64_t k)
             : m_wdata(&wdata)
             , m_topk(k)
         {}
 
-        template <typename Index>
-        uint64_t operator()(Index const& index, term_id_vec terms)
+        template <typename Index, typename Filter = no_filter>
+        uint64_t operator()(Index const& index, term_id_vec terms,
+                            docid_range const& range = docid_range(),
+                            Filter const& filter = Filter())
         {
             m_topk.clear();
-            if (terms.empty()) return 0;
+            if (terms.empty() || range.empty_in(index.num_docs())) return 0;
 
             auto query_term_freqs = query_freqs(terms);
 
@@ -359,9 +812,12 @@ namespace ds2i {
                           return lhs.docs_enum.size() < rhs.docs_enum.size();
                       });
 
+            uint64_t end = range.end_in(num_docs);
+            auto filter_cursor = filter.get_cursor();
+            range.skip_to_begin(enums[0].docs_enum);
             uint64_t candidate = enums[0].docs_enum.docid();
             size_t i = 1;
-            while (candidate < index.num_docs()) {
+            while (candidate < end) {
                 for (; i < enums.size(); ++i) {
                     enums[i].docs_enum.next_geq(candidate);
                     if (enums[i].docs_enum.docid() != candidate) {
@@ -371,15 +827,22 @@ namespace ds2i {
                     }
                 }
 
+                // the filter is the last list to intersect
                 if (i == enums.size()) {
-                    float norm_len = m_wdata->norm_len(candidate);
+                    uint64_t allowed = filter_cursor.next_geq(candidate);
+                    if (allowed != candidate) {
+                        candidate = allowed;
+                        i = 0;
+                        continue;
+                    }
+                    auto doc_norms = m_wdata->doc_norms(candidate);
                     float score = 0;
                     for (i = 0; i < enums.size(); ++i) {
-                        score += enums[i].q_weight * scorer_type::doc_term_weight
-                            (enums[i].docs_enum.freq(), norm_len);
+                        score += enums[i].q_weight * m_wdata->doc_term_weight
+                            (enums[i].docs_enum, doc_norms);
                     }
 
-                    m_topk.insert(score);
+                    m_topk.insert(score, candidate);
                     enums[0].docs_enum.next();
                     candidate = enums[0].docs_enum.docid();
                     i = 1;
@@ -390,35 +853,171 @@ namespace ds2i {
             return m_topk.topk().size();
         }
 
-        std::vector<float> const& topk() const
+        std::vector<topk_queue::entry_type> const& topk() const
         {
             return m_topk.topk();
         }
 
     private:
-        wand_data<scorer_type> const* m_wdata;
+        WandData const* m_wdata;
         topk_queue m_topk;
     };
 
+    typedef basic_ranked_and_query<wand_data<>> ranked_and_query;
 
-    struct ranked_or_query {
+    // Conjunctive top-k for collections whose docids are assigned by
+    // decreasing static rank (for example PageRank): the score of a
+    // document is its BM25 score plus static_weight times its static
+    // score, which must be non-increasing with the docid. Then the sum of
+    // the max weights of the terms plus the static score of the current
+    // candidate bounds the score of all the following documents, and the
+    // intersection stops as soon as the bound cannot enter the top-k;
+    // with a large static_weight this happens after about k matches.
+    template <typename WandData>
+    struct basic_static_rank_and_query {
 
-        typedef bm25 scorer_type;
+        typedef typename WandData::scorer_type scorer_type;
 
-        ranked_or_query(wand_data<scorer_type> const& wdata, uint64_t k)
+        basic_static_rank_and_query(WandData const& wdata, uint64_t k,
+                                    std::vector<float> const& static_scores,
+                                    float static_weight)
             : m_wdata(&wdata)
             , m_topk(k)
+            , m_static_scores(&static_scores)
+            , m_static_weight(static_weight)
+        {
+            if (static_weight < 0) {
+                throw std::invalid_argument("Static weight must be non-negative");
+            }
+            if (std::is_sorted(static_scores.rbegin(), static_scores.rend())) return;
+            throw std::invalid_argument("Static scores must be non-increasing");
+        }
+
+        template <typename Index, typename Filter = no_filter>
+        uint64_t operator()(Index const& index, term_id_vec terms,
+                            docid_range const& range = docid_range(),
+                            Filter const& filter = Filter())
+        {
+            m_topk.clear();
+            if (terms.empty() || range.empty_in(index.num_docs())) return 0;
+            if (m_static_scores->size() < index.num_docs()) {
+                throw std::invalid_argument("Missing static scores");
+            }
+
+            auto query_term_freqs = query_freqs(terms);
+
+            uint64_t num_docs = index.num_docs();
+            typedef typename Index::document_enumerator enum_type;
+            struct scored_enum {
+                enum_type docs_enum;
+                float q_weight;
+            };
+
+            std::vector<scored_enum> enums;
+            enums.reserve(query_term_freqs.size());
+
+            float max_score = 0;
+            for (auto term: query_term_freqs) {
+                auto list = index[term.first];
+                auto q_weight = scorer_type::query_term_weight
+                    (term.second, list.size(), num_docs);
+                max_score += q_weight * m_wdata->max_term_weight(term.first);
+                enums.push_back(scored_enum {std::move(list), q_weight});
+            }
+
+            // sort by increasing frequency
+            std::sort(enums.begin(), enums.end(),
+                      [](scored_enum const& lhs, scored_enum const& rhs) {
+                          return lhs.docs_enum.size() < rhs.docs_enum.size();
+                      });
+
+            auto const& static_scores = *m_static_scores;
+            uint64_t end = range.end_in(num_docs);
+            auto filter_cursor = filter.get_cursor();
+            range.skip_to_begin(enums[0].docs_enum);
+            uint64_t candidate = enums[0].docs_enum.docid();
+            size_t i = 1;
+            while (candidate < end) {
+                // no following document can enter the top-k
+                if (!m_topk.would_enter(max_score + m_static_weight *
+                                        static_scores[candidate])) {
+                    break;
+                }
+
+                for (; i < enums.size(); ++i) {
+                    enums[i].docs_enum.next_geq(candidate);
+                    if (enums[i].docs_enum.docid() != candidate) {
+                        candidate = enums[i].docs_enum.docid();
+                        i = 0;
+                        break;
+                    }
+                }
+
+                // the filter is the last list to intersect
+                if (i == enums.size()) {
+                    uint64_t allowed = filter_cursor.next_geq(candidate);
+                    if (allowed != candidate) {
+                        candidate = allowed;
+                        i = 0;
+                        continue;
+                    }
+                    auto doc_norms = m_wdata->doc_norms(candidate);
+                    float score = m_static_weight * static_scores[candidate];
+                    for (i = 0; i < enums.size(); ++i) {
+                        score += enums[i].q_weight * m_wdata->doc_term_weight
+                            (enums[i].docs_enum, doc_norms);
+                    }
+
+                    m_topk.insert(score, candidate);
+                    enums[0].docs_enum.next();
+                    candidate = enums[0].docs_enum.docid();
+                    i = 1;
+                }
+            }
+
+            m_topk.finalize();
+            return m_topk.topk().size();
+        }
+
+        std::vector<topk_queue::entry_type> const& topk() const
+        {
+            return m_topk.topk();
+        }
+
+    private:
+        WandData const* m_wdata;
+        topk_queue m_topk;
+        std::vector<float> const* m_static_scores;
+        float m_static_weight;
+    };
+
+    typedef basic_static_rank_and_query<wand_data<>> static_rank_and_query;
+
+
+    template <typename WandData>
+    struct basic_ranked_or_query {
+
+        typedef typename WandData::scorer_type scorer_type;
+
+        basic_ranked_or_query(WandData const& wdata, uint64_t k,
+                              size_t heap_threshold = configuration::get().heap_or_threshold)
+            : m_wdata(&wdata)
+            , m_topk(k)
+            , m_heap_threshold(heap_threshold)
         {}
 
-        template <typename Index>
-        uint64_t operator()(Index const& index, term_id_vec terms)
+        template <typename Index, typename Filter = no_filter>
+        uint64_t operator()(Index const& index, term_id_vec terms,
+                            docid_range const& range = docid_range(),
+                            Filter const& filter = Filter())
         {
             m_topk.clear();
-            if (terms.empty()) return 0;
+            if (terms.empty() || range.empty_in(index.num_docs())) return 0;
 
             auto query_term_freqs = query_freqs(terms);
 
             uint64_t num_docs = index.num_docs();
+            uint64_t end = range.end_in(num_docs);
             typedef typename Index::document_enumerator enum_type;
             struct scored_enum {
                 enum_type docs_enum;
@@ -432,9 +1031,48 @@ namespace ds2i {
                 auto list = index[term.first];
                 auto q_weight = scorer_type::query_term_weight
                     (term.second, list.size(), num_docs);
+                range.skip_to_begin(list);
                 enums.push_back(scored_enum {std::move(list), q_weight});
             }
 
+            auto filter_cursor = filter.get_cursor();
+            if (enums.size() >= m_heap_threshold) {
+                std::vector<scored_enum*> ptrs;
+                for (auto& e: enums) ptrs.push_back(&e);
+                docid_heap<scored_enum, scored_enum_docid> heap(std::move(ptrs));
+
+                uint64_t cur_doc = heap.top_docid();
+                while (cur_doc < end) {
+                    uint64_t allowed = filter_cursor.next_geq(cur_doc);
+                    if (allowed != cur_doc) {
+                        // skip the docids that are filtered out
+                        if (allowed >= end) break;
+                        do {
+                            heap.top()->docs_enum.next_geq(allowed);
+                            heap.update_top();
+                        } while (heap.top_docid() < allowed);
+                        cur_doc = heap.top_docid();
+                        continue;
+                    }
+
+                    float score = 0;
+                    auto doc_norms = m_wdata->doc_norms(cur_doc);
+                    do {
+                        scored_enum* en = heap.top();
+                        score += en->q_weight * m_wdata->doc_term_weight
+                            (en->docs_enum, doc_norms);
+                        en->docs_enum.next();
+                        heap.update_top();
+                    } while (heap.top_docid() == cur_doc);
+
+                    m_topk.insert(score, cur_doc);
+                    cur_doc = heap.top_docid();
+                }
+
+                m_topk.finalize();
+                return m_topk.topk().size();
+            }
+
             uint64_t cur_doc =
                 std::min_element(enums.begin(), enums.end(),
                                  [](scored_enum const& lhs, scored_enum const& rhs) {
@@ -442,14 +1080,24 @@ namespace ds2i {
                                  })
                 ->docs_enum.docid();
 
-            while (cur_doc < index.num_docs()) {
+            while (cur_doc < end) {
+                uint64_t allowed = filter_cursor.next_geq(cur_doc);
+                if (allowed != cur_doc) {
+                    if (allowed >= end) break;
+                    cur_doc = skip_to(enums.begin(), enums.end(), allowed, num_docs,
+                                      [](scored_enum& en) -> enum_type& {
+                                          return en.docs_enum;
+                                      });
+                    continue;
+                }
+
                 float score = 0;
-                float norm_len = m_wdata->norm_len(cur_doc);
+                auto doc_norms = m_wdata->doc_norms(cur_doc);
                 uint64_t next_doc = index.num_docs();
                 for (size_t i = 0; i < enums.size(); ++i) {
                     if (enums[i].docs_enum.docid() == cur_doc) {
-                        score += enums[i].q_weight * scorer_type::doc_term_weight
-                            (enums[i].docs_enum.freq(), norm_len);
+                        score += enums[i].q_weight * m_wdata->doc_term_weight
+                            (enums[i].docs_enum, doc_norms);
                         enums[i].docs_enum.next();
                     }
                     if (enums[i].docs_enum.docid() < next_doc) {
@@ -457,7 +1105,7 @@ namespace ds2i {
                     }
                 }
 
-                m_topk.insert(score);
+                m_topk.insert(score, cur_doc);
                 cur_doc = next_doc;
             }
 
@@ -465,34 +1113,44 @@ namespace ds2i {
             return m_topk.topk().size();
         }
 
-        std::vector<float> const& topk() const
+        std::vector<topk_queue::entry_type> const& topk() const
         {
             return m_topk.topk();
         }
 
     private:
-        wand_data<scorer_type> const* m_wdata;
+        WandData const* m_wdata;
         topk_queue m_topk;
+        size_t m_heap_threshold;
     };
 
-    struct maxscore_query {
+    typedef basic_ranked_or_query<wand_data<>> ranked_or_query;
 
-        typedef bm25 scorer_type;
+    template <typename WandData>
+    struct basic_maxscore_query {
 
-        maxscore_query(wand_data<scorer_type> const& wdata, uint64_t k)
+        typedef typename WandData::scorer_type scorer_type;
+
+        basic_maxscore_query(WandData const& wdata, uint64_t k,
+                             float threshold_factor =
+                             configuration::get().threshold_factor)
             : m_wdata(&wdata)
             , m_topk(k)
+            , m_threshold_factor(check_threshold_factor(threshold_factor))
         {}
 
-        template <typename Index>
-        uint64_t operator()(Index const& index, term_id_vec const& terms)
+        template <typename Index, typename Filter = no_filter>
+        uint64_t operator()(Index const& index, term_id_vec const& terms,
+                            docid_range const& range = docid_range(),
+                            Filter const& filter = Filter())
         {
             m_topk.clear();
-            if (terms.empty()) return 0;
+            if (terms.empty() || range.empty_in(index.num_docs())) return 0;
 
             auto query_term_freqs = query_freqs(terms);
 
             uint64_t num_docs = index.num_docs();
+            uint64_t end = range.end_in(num_docs);
             typedef typename Index::document_enumerator enum_type;
             struct scored_enum {
                 enum_type docs_enum;
@@ -508,14 +1166,20 @@ namespace ds2i {
                 auto q_weight = scorer_type::query_term_weight
                     (term.second, list.size(), num_docs);
                 auto max_weight = q_weight * m_wdata->max_term_weight(term.first);
-                enums.push_back(scored_enum {std::move(list), q_weight, max_weight});
+                range.skip_to_begin(list);
+                push_tiers(index, std::move(list), q_weight, max_weight, enums);
             }
 
+            // the lists with no postings in the range do not contribute
+            // to the upper bounds
             std::vector<scored_enum*> ordered_enums;
             ordered_enums.reserve(enums.size());
             for (auto& en: enums) {
-                ordered_enums.push_back(&en);
+                if (en.docs_enum.docid() < end) {
+                    ordered_enums.push_back(&en);
+                }
             }
+            if (ordered_enums.empty()) return 0;
 
             // sort enumerators by increasing maxscore
             std::sort(ordered_enums.begin(), ordered_enums.end(),
@@ -537,15 +1201,28 @@ namespace ds2i {
                                  })
                 ->docs_enum.docid();
 
+            auto filter_cursor = filter.get_cursor();
             while (non_essential_lists < ordered_enums.size() &&
-                   cur_doc < index.num_docs()) {
+                   cur_doc < end) {
+                uint64_t allowed = filter_cursor.next_geq(cur_doc);
+                if (allowed != cur_doc) {
+                    // only the essential lists drive the candidates
+                    if (allowed >= end) break;
+                    cur_doc = skip_to(ordered_enums.begin() + non_essential_lists,
+                                      ordered_enums.end(), allowed, num_docs,
+                                      [](scored_enum* en) -> enum_type& {
+                                          return en->docs_enum;
+                                      });
+                    continue;
+                }
+
                 float score = 0;
-                float norm_len = m_wdata->norm_len(cur_doc);
+                auto doc_norms = m_wdata->doc_norms(cur_doc);
                 uint64_t next_doc = index.num_docs();
                 for (size_t i = non_essential_lists; i < ordered_enums.size(); ++i) {
                     if (ordered_enums[i]->docs_enum.docid() == cur_doc) {
-                        score += ordered_enums[i]->q_weight * scorer_type::doc_term_weight
-                            (ordered_enums[i]->docs_enum.freq(), norm_len);
+                        score += ordered_enums[i]->q_weight * m_wdata->doc_term_weight
+                            (ordered_enums[i]->docs_enum, doc_norms);
                         ordered_enums[i]->docs_enum.next();
                     }
                     if (ordered_enums[i]->docs_enum.docid() < next_doc) {
@@ -555,20 +1232,22 @@ namespace ds2i {
 
                 // try to complete evaluation with non-essential lists
                 for (size_t i = non_essential_lists - 1; i + 1 > 0; --i) {
-                    if (!m_topk.would_enter(score + upper_bounds[i])) {
+                    if (!m_topk.would_enter((score + upper_bounds[i]) /
+                                            m_threshold_factor)) {
                         break;
                     }
                     ordered_enums[i]->docs_enum.next_geq(cur_doc);
                     if (ordered_enums[i]->docs_enum.docid() == cur_doc) {
-                        score += ordered_enums[i]->q_weight * scorer_type::doc_term_weight
-                            (ordered_enums[i]->docs_enum.freq(), norm_len);
+                        score += ordered_enums[i]->q_weight * m_wdata->doc_term_weight
+                            (ordered_enums[i]->docs_enum, doc_norms);
                     }
                 }
 
-                if (m_topk.insert(score)) {
+                if (m_topk.insert(score, cur_doc)) {
                     // update non-essential lists
                     while (non_essential_lists < ordered_enums.size() &&
-                           !m_topk.would_enter(upper_bounds[non_essential_lists])) {
+                           !m_topk.would_enter(upper_bounds[non_essential_lists] /
+                                               m_threshold_factor)) {
                         non_essential_lists += 1;
                     }
                 }
@@ -580,15 +1259,18 @@ namespace ds2i {
             return m_topk.topk().size();
         }
 
-        std::vector<float> const& topk() const
+        std::vector<topk_queue::entry_type> const& topk() const
         {
             return m_topk.topk();
         }
 
     private:
-        wand_data<scorer_type> const* m_wdata;
+        WandData const* m_wdata;
         topk_queue m_topk;
+        float m_threshold_factor;
     };
 
+    typedef basic_maxscore_query<wand_data<>> maxscore_query;
+
 
 }
@@ -0,0 +1,417 @@
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <queue>
+
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <succinct/mapper.hpp>
+
+#include "configuration.hpp"
+#include "index_types.hpp"
+#include "wand_data.hpp"
+#include "queries.hpp"
+#include "util.hpp"
+
+// Resident query server: the index and the wand data are mapped and
+// warmed up once, then queries are read from a Unix domain socket.
+//
+// Each request line has the form
+//
+//     <query type> <k> <term id> <term id> ...
+//
+// where the query type is one of and, or, ranked_and, ranked_or, wand,
+// maxscore, and k is ignored by the unranked ones. A batch is terminated
+// by an empty line or by the end of the connection; its queries are run
+// in parallel on DS2I_THREADS threads, and answered in order with one
+// JSON line each, followed by an empty line:
+//
+//     {"query": 0, "type": "wand", "count": 10, "time_usecs": 153, "results": [[docid, score], ...]}
+//
+// An invalid or failed query is answered with {"query": 0, "error": "..."}.
+//
+// At most DS2I_MAX_CONNECTIONS connections are served at a time, each on
+// its own thread; the others wait in the listen backlog until one closes.
+
+namespace {
+
+    class thread_pool {
+    public:
+        thread_pool(size_t n_threads)
+            : m_done(false)
+        {
+            for (size_t i = 0; i < n_threads; ++i) {
+                m_threads.emplace_back([this]() { work(); });
+            }
+        }
+
+        ~thread_pool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_done = true;
+            }
+            m_cv.notify_all();
+            for (auto& t: m_threads) t.join();
+        }
+
+        std::future<void> submit(std::function<void()> f)
+        {
+            auto task = std::make_shared<std::packaged_task<void()>>(f);
+            auto ret = task->get_future();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_jobs.push([task]() { (*task)(); });
+            }
+            m_cv.notify_one();
+            return ret;
+        }
+
+    private:
+        void work()
+        {
+            while (true) {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_cv.wait(lock, [this]() { return m_done || !m_jobs.empty(); });
+                    if (m_jobs.empty()) return;
+                    job = std::move(m_jobs.front());
+                    m_jobs.pop();
+                }
+                job();
+            }
+        }
+
+        bool m_done;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::queue<std::function<void()>> m_jobs;
+        std::vector<std::thread> m_threads;
+    };
+
+    // Counting semaphore bounding the connections served at a time
+    class connection_slots {
+    public:
+        connection_slots(size_t slots)
+            : m_free(slots)
+        {}
+
+        void acquire()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this]() { return m_free > 0; });
+            m_free -= 1;
+        }
+
+        void release()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_free += 1;
+            }
+            m_cv.notify_one();
+        }
+
+    private:
+        size_t m_free;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+    };
+
+    class socket_stream {
+    public:
+        socket_stream(int fd)
+            : m_fd(fd)
+            , m_pos(0)
+        {}
+
+        ~socket_stream()
+        {
+            close(m_fd);
+        }
+
+        bool read_line(std::string& line)
+        {
+            line.clear();
+            while (true) {
+                size_t newline = m_buf.find('\n', m_pos);
+                if (newline != std::string::npos) {
+                    line.assign(m_buf, m_pos, newline - m_pos);
+                    m_pos = newline + 1;
+                    return true;
+                }
+                m_buf.erase(0, m_pos);
+                m_pos = 0;
+
+                char chunk[1 << 16];
+                ssize_t n = recv(m_fd, chunk, sizeof(chunk), 0);
+                if (n <= 0) {
+                    // last line without newline
+                    line.swap(m_buf);
+                    m_buf.clear();
+                    return !line.empty();
+                }
+                m_buf.append(chunk, n);
+            }
+        }
+
+        bool write(std::string const& data)
+        {
+            size_t written = 0;
+            while (written < data.size()) {
+                ssize_t n = send(m_fd, data.data() + written,
+                                 data.size() - written, MSG_NOSIGNAL);
+                if (n <= 0) return false;
+                written += n;
+            }
+            return true;
+        }
+
+    private:
+        int m_fd;
+        std::string m_buf;
+        size_t m_pos;
+    };
+
+    template <typename QueryOperator, typename IndexType>
+    uint64_t run_ranked(QueryOperator query_op,
+                        IndexType const& index,
+                        ds2i::term_id_vec const& terms,
+                        std::vector<ds2i::topk_queue::entry_type>& results)
+    {
+        uint64_t count = query_op(index, terms);
+        results = query_op.topk();
+        return count;
+    }
+
+    std::string error_response(size_t query_id, std::string const& message)
+    {
+        std::ostringstream os;
+        os << "{\"query\": " << query_id
+           << ", \"error\": \"" << message << "\"}\n";
+        return os.str();
+    }
+
+    // Runs a query described by a request line and returns its response
+    template <typename IndexType>
+    std::string run_query(IndexType const& index,
+                          ds2i::wand_data<> const* wdata,
+                          size_t query_id,
+                          std::string const& request)
+    {
+        using namespace ds2i;
+
+        std::istringstream is(request);
+        std::string type;
+        uint64_t k = 0;
+        term_id_vec terms;
+        term_id_type term_id;
+        is >> type >> k;
+        while (is >> term_id) {
+            if (term_id >= index.size()) {
+                return error_response(query_id, "Term id out of range");
+            }
+            terms.push_back(term_id);
+        }
+
+        bool ranked = type != "and" && type != "or";
+        if (type.empty() || (ranked && (!wdata || !k))) {
+            return error_response(query_id, "Invalid request");
+        }
+
+        uint64_t count = 0;
+        std::vector<topk_queue::entry_type> results;
+        auto tick = get_time_usecs();
+        if (type == "and") {
+            count = and_query<false>()(index, terms);
+        } else if (type == "or") {
+            count = or_query<false>()(index, terms);
+        } else if (type == "ranked_and") {
+            count = run_ranked(ranked_and_query(*wdata, k), index, terms, results);
+        } else if (type == "ranked_or") {
+            count = run_ranked(ranked_or_query(*wdata, k), index, terms, results);
+        } else if (type == "wand") {
+            count = run_ranked(wand_query(*wdata, k), index, terms, results);
+        } else if (type == "maxscore") {
+            count = run_ranked(maxscore_query(*wdata, k), index, terms, results);
+        } else {
+            return error_response(query_id, "Unsupported query type");
+        }
+        double elapsed = double(get_time_usecs() - tick);
+
+        std::ostringstream os;
+        os << "{\"query\": " << query_id
+           << ", \"type\": \"" << type << "\""
+           << ", \"count\": " << count
+           << ", \"time_usecs\": " << elapsed;
+        if (ranked) {
+            os << ", \"results\": [";
+            for (size_t i = 0; i < results.size(); ++i) {
+                os << (i ? ", " : "") << "[" << results[i].second
+                   << ", " << results[i].first << "]";
+            }
+            os << "]";
+        }
+        os << "}\n";
+        return os.str();
+    }
+
+    template <typename IndexType>
+    void serve_connection(IndexType const& index,
+                          ds2i::wand_data<> const* wdata,
+                          thread_pool& pool,
+                          int fd)
+    {
+        socket_stream stream(fd);
+        std::string line;
+        std::vector<std::string> batch;
+        bool open = true;
+
+        while (open) {
+            batch.clear();
+            while ((open = stream.read_line(line)) && !line.empty()) {
+                batch.push_back(line);
+            }
+            if (batch.empty()) continue;
+
+            std::vector<std::string> responses(batch.size());
+            std::vector<std::future<void>> done;
+            for (size_t i = 0; i < batch.size(); ++i) {
+                done.push_back(pool.submit([&, i]() {
+                            // a failed query must not bring down the server
+                            try {
+                                responses[i] = run_query(index, wdata, i, batch[i]);
+                            } catch (std::exception const& e) {
+                                ds2i::logger() << "ERROR: query \"" << batch[i]
+                                               << "\" failed: " << e.what() << std::endl;
+                                responses[i] = error_response(i, "Query failed");
+                            } catch (...) {
+                                responses[i] = error_response(i, "Query failed");
+                            }
+                        }));
+            }
+            for (auto& f: done) f.get();
+
+            std::string out;
+            for (auto const& r: responses) out += r;
+            out += "\n";
+            if (!stream.write(out)) break;
+        }
+    }
+}
+
+template <typename IndexType>
+void serve(const char* index_filename,
+           const char* wand_data_filename,
+           const char* socket_path)
+{
+    using namespace ds2i;
+
+    IndexType index;
+    logger() << "Loading index from " << index_filename << std::endl;
+    boost::iostreams::mapped_file_source m(index_filename);
+    succinct::mapper::map(index, m);
+
+    logger() << "Warming up posting lists" << std::endl;
+    for (size_t i = 0; i < index.size(); ++i) {
+        index.warmup(i);
+    }
+
+    wand_data<> wdata;
+    boost::iostreams::mapped_file_source md;
+    if (wand_data_filename) {
+        md.open(wand_data_filename);
+        succinct::mapper::map(wdata, md, succinct::mapper::map_flags::warmup);
+    }
+
+    int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server_fd < 0) {
+        throw std::runtime_error("Cannot create socket");
+    }
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        throw std::invalid_argument("Socket path too long");
+    }
+    strcpy(addr.sun_path, socket_path);
+    unlink(socket_path);
+    if (bind(server_fd, (sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(server_fd, 64) < 0) {
+        throw std::runtime_error(std::string("Cannot listen on ") + socket_path
+                                 + ": " + strerror(errno));
+    }
+
+    // with no workers the submitted queries would never run
+    size_t n_threads = std::max(configuration::get().worker_threads, size_t(1));
+    thread_pool pool(n_threads);
+    size_t max_connections = std::max(configuration::get().max_connections, size_t(1));
+    connection_slots slots(max_connections);
+    logger() << "Listening on " << socket_path << " with "
+             << n_threads << " threads, at most "
+             << max_connections << " connections" << std::endl;
+
+    wand_data<> const* wdata_ptr = wand_data_filename ? &wdata : nullptr;
+    while (true) {
+        slots.acquire();
+        int fd = accept(server_fd, nullptr, nullptr);
+        if (fd < 0) {
+            slots.release();
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("accept failed: ") + strerror(errno));
+        }
+        std::thread([&, fd]() {
+                try {
+                    serve_connection(index, wdata_ptr, pool, fd);
+                } catch (std::exception const& e) {
+                    logger() << "ERROR: connection failed: " << e.what() << std::endl;
+                }
+                slots.release();
+            }).detach();
+    }
+}
+
+int main(int argc, const char** argv)
+{
+    using namespace ds2i;
+
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <index type> <index filename> <socket path> [<wand data filename>]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string type = argv[1];
+    const char* index_filename = argv[2];
+    const char* socket_path = argv[3];
+    const char* wand_data_filename = nullptr;
+    if (argc > 4) {
+        wand_data_filename = argv[4];
+    }
+
+    if (false) {
+#define LOOP_BODY(R, DATA, T)                                   \
+        } else if (type == BOOST_PP_STRINGIZE(T)) {             \
+            serve<BOOST_PP_CAT(T, _index)>                      \
+                (index_filename, wand_data_filename, socket_path); \
+            /**/
+
+        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_INDEX_TYPES);
+#undef LOOP_BODY
+    } else {
+        logger() << "ERROR: Unknown type " << type << std::endl;
+    }
+
+}
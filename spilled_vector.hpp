@@ -0,0 +1,173 @@
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include <succinct/mapper.hpp>
+
+#include "configuration.hpp"
+#include "util.hpp"
+
+namespace ds2i {
+
+    // Returns a new file name in DS2I_SPILL_DIR, or an empty string if
+    // the index builders should keep their data in memory
+    inline std::string spill_filename()
+    {
+        static std::atomic<uint64_t> counter(0);
+        std::string const& dir = configuration::get().spill_dir;
+        if (dir.empty()) return std::string();
+        return dir + "/ds2i_spill." + std::to_string(getpid())
+            + "." + std::to_string(counter++);
+    }
+
+    // Appends values of type T to a file laid out as a frozen
+    // mappable_vector<T>, possibly preceded by some uint64_t fields (for
+    // example the length of a bit_vector), so that the data can be mapped
+    // back once complete instead of being accumulated in memory. The file
+    // is unlinked as soon as it is mapped (unless it is resumable), and
+    // the mapping is returned to the caller, which keeps it as long as
+    // the mapped structure.
+    template <typename T>
+    class spilled_vector {
+    public:
+        spilled_vector(std::string const& filename, size_t prefix_fields = 0)
+            : m_filename(filename)
+            , m_fout(filename.c_str(), std::ios::binary | std::ios::trunc)
+            , m_prefix_fields(prefix_fields)
+            , m_size(0)
+            , m_mapped(false)
+            , m_resumable(false)
+        {
+            if (!m_fout) {
+                throw std::runtime_error("Cannot open spill file " + filename);
+            }
+            // freeze flags, prefix fields and vector size, filled in map()
+            for (size_t i = 0; i < 2 + m_prefix_fields; ++i) {
+                write_word(0);
+            }
+        }
+
+        // Opens a resumable file, for a build with checkpoints: the first
+        // resume_size values are kept from a previous run (the file is
+        // created if resume_size is zero), and the file is never removed
+        // by the spilled_vector, not even by map(), so that the build can
+        // be resumed after an error until the checkpoint is removed
+        spilled_vector(std::string const& filename, size_t prefix_fields,
+                       uint64_t resume_size)
+            : m_filename(filename)
+            , m_prefix_fields(prefix_fields)
+            , m_size(resume_size)
+            , m_mapped(false)
+            , m_resumable(true)
+        {
+            if (!resume_size) {
+                m_fout.open(filename.c_str(), std::ios::binary | std::ios::trunc);
+                for (size_t i = 0; i < 2 + m_prefix_fields; ++i) {
+                    write_word(0);
+                }
+            } else {
+                uint64_t offset = (2 + m_prefix_fields) * sizeof(uint64_t);
+                std::ifstream fin(filename.c_str(), std::ios::binary | std::ios::ate);
+                if (!fin || uint64_t(fin.tellg()) < offset + resume_size * sizeof(T)) {
+                    throw std::runtime_error("Spill file " + filename
+                                             + " is shorter than its checkpoint");
+                }
+                fin.close();
+                if (::truncate(filename.c_str(), off_t(offset + resume_size * sizeof(T)))) {
+                    throw std::runtime_error("Cannot truncate spill file " + filename);
+                }
+                m_fout.open(filename.c_str(),
+                            std::ios::binary | std::ios::in | std::ios::out | std::ios::ate);
+            }
+            if (!m_fout) {
+                throw std::runtime_error("Cannot open spill file " + filename);
+            }
+        }
+
+        ~spilled_vector()
+        {
+            if (!m_mapped && !m_resumable) {
+                m_fout.close();
+                std::remove(m_filename.c_str());
+            }
+        }
+
+        void append(T const* data, size_t n)
+        {
+            m_fout.write(reinterpret_cast<const char*>(data), sizeof(T) * n);
+            m_size += n;
+        }
+
+        void append(std::vector<T> const& v)
+        {
+            append(v.data(), v.size());
+        }
+
+        uint64_t size() const
+        {
+            return m_size;
+        }
+
+        // Writes the buffered values to the file, and syncs it to disk,
+        // before a checkpoint
+        void flush()
+        {
+            m_fout.flush();
+            if (!m_fout) {
+                throw std::runtime_error("Error writing spill file " + m_filename);
+            }
+            sync_file(m_filename);
+        }
+
+        typedef std::shared_ptr<boost::iostreams::mapped_file_source> mapping_type;
+
+        // Maps the data into val, whose map() must visit the prefix
+        // fields and then a single mappable_vector<T>; the returned
+        // mapping must live as long as val
+        template <typename Mappable>
+        mapping_type map(Mappable& val, std::vector<uint64_t> const& prefix = {})
+        {
+            assert(prefix.size() == m_prefix_fields);
+            m_fout.seekp(sizeof(uint64_t));
+            for (auto field: prefix) {
+                write_word(field);
+            }
+            write_word(m_size);
+            m_fout.close();
+            if (!m_fout) {
+                throw std::runtime_error("Error writing spill file " + m_filename);
+            }
+
+            mapping_type file(new boost::iostreams::mapped_file_source(m_filename));
+            succinct::mapper::map(val, *file);
+            if (!m_resumable) {
+                std::remove(m_filename.c_str());
+            }
+            m_mapped = true;
+            return file;
+        }
+
+    private:
+        void write_word(uint64_t word)
+        {
+            m_fout.write(reinterpret_cast<const char*>(&word), sizeof(word));
+        }
+
+        std::string m_filename;
+        std::ofstream m_fout;
+        size_t m_prefix_fields;
+        uint64_t m_size;
+        bool m_mapped;
+        bool m_resumable;
+    };
+}
@@ -0,0 +1,39 @@
+#define BOOST_TEST_MODULE auto_sampling_sequence
+
+#include "test_generic_sequence.hpp"
+
+#include "auto_sampling_sequence.hpp"
+#include "compact_elias_fano.hpp"
+#include "partitioned_sequence.hpp"
+#include <vector>
+#include <cstdlib>
+
+BOOST_AUTO_TEST_CASE(auto_sampling_sequence)
+{
+    ds2i::global_parameters params;
+
+    typedef ds2i::auto_sampling_sequence<> sequence_type;
+
+    std::vector<uint64_t> sizes = { 1, 500, 5000 };
+    std::vector<double> avg_gaps = { 1.1, 3, 10 };
+    for (auto n: sizes) {
+        for (auto avg_gap: avg_gaps) {
+            uint64_t universe = uint64_t(n * avg_gap) + 1;
+            auto seq = random_sequence(universe, n, true);
+
+            test_sequence(ds2i::auto_sampling_sequence<ds2i::compact_elias_fano>(),
+                          params, universe, seq);
+            test_sequence(sequence_type(), params, universe, seq);
+            test_sequence(ds2i::auto_sampling_sequence<ds2i::partitioned_sequence<>>(),
+                          params, universe, seq);
+
+            // the lists long enough to get the denser samplings are too
+            // slow to test, so check all the parameters on the base sequence
+            for (size_t type = 0; type < sequence_type::sampling_types; ++type) {
+                auto sparams = sequence_type::sampling_params
+                    (params, sequence_type::sampling_type(type));
+                test_sequence(ds2i::indexed_sequence(), sparams, universe, seq);
+            }
+        }
+    }
+}
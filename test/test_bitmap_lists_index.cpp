@@ -0,0 +1,111 @@
+#define BOOST_TEST_MODULE bitmap_lists_index
+
+#include "succinct/test_common.hpp"
+
+#include "ds2i_config.hpp"
+#include "index_types.hpp"
+#include "queries.hpp"
+
+#include <vector>
+#include <numeric>
+
+namespace ds2i { namespace test {
+
+    struct index_initialization {
+
+        typedef block_optpfor_index base_index_type;
+        typedef bitmap_lists_index<base_index_type> index_type;
+
+        index_initialization()
+            : collection(DS2I_SOURCE_DIR "/test/test_data/test_collection")
+        {
+            base_index_type::builder base_builder(collection.num_docs(), params);
+            index_type::builder builder(collection.num_docs(), params);
+            for (auto const& plist: collection) {
+                uint64_t freqs_sum = std::accumulate(plist.freqs.begin(),
+                                                     plist.freqs.end(), uint64_t(0));
+                base_builder.add_posting_list(plist.docs.size(), plist.docs.begin(),
+                                              plist.freqs.begin(), freqs_sum);
+                builder.add_posting_list(plist.docs.size(), plist.docs.begin(),
+                                         plist.freqs.begin(), freqs_sum);
+            }
+            base_builder.build(base_index);
+            builder.build(index);
+
+            term_id_vec q;
+            std::ifstream qfile("test_data/queries");
+            while (read_query(q, qfile)) queries.push_back(q);
+        }
+
+        global_parameters params;
+        binary_freq_collection collection;
+        base_index_type base_index;
+        index_type index;
+        std::vector<term_id_vec> queries;
+    };
+
+}}
+
+BOOST_FIXTURE_TEST_CASE(bitmaps,
+                        ds2i::test::index_initialization)
+{
+    BOOST_REQUIRE(index.num_bitmaps() > 0);
+    uint64_t num_bitmaps = 0;
+    size_t s = 0;
+    for (auto const& plist: collection) {
+        auto e = index[s++];
+        BOOST_REQUIRE_EQUAL(plist.docs.size(), e.size());
+        bool dense = plist.docs.size() * index.min_density_inverse >= index.num_docs();
+        BOOST_REQUIRE_EQUAL(dense, e.has_bitmap());
+        if (!e.has_bitmap()) continue;
+        num_bitmaps += 1;
+
+        std::vector<bool> docs(index.num_docs());
+        for (auto docid: plist.docs) docs[docid] = true;
+        for (size_t docid = 0; docid < index.num_docs(); ++docid) {
+            MY_REQUIRE_EQUAL(docs[docid], e.contains(docid),
+                             "s = " << s << " docid = " << docid);
+        }
+    }
+    BOOST_REQUIRE_EQUAL(num_bitmaps, index.num_bitmaps());
+}
+
+BOOST_FIXTURE_TEST_CASE(bitmap_and,
+                        ds2i::test::index_initialization)
+{
+    // add some queries made only of lists with a bitmap
+    std::vector<ds2i::term_id_type> bitmap_terms;
+    for (size_t i = 0; i < index.size(); ++i) {
+        if (index[i].has_bitmap()) bitmap_terms.push_back(i);
+    }
+    for (size_t i = 0; i + 2 < bitmap_terms.size(); i += 3) {
+        queries.push_back({bitmap_terms[i], bitmap_terms[i + 1], bitmap_terms[i + 2]});
+        queries.push_back({bitmap_terms[i]});
+    }
+
+    ds2i::and_query<false> and_q;
+    ds2i::and_query<true> and_freq_q;
+    // the ranges are not aligned to the bitmap words
+    uint64_t n = index.num_docs();
+    std::vector<ds2i::docid_range> ranges = {
+        ds2i::docid_range(),
+        ds2i::docid_range(0, n / 3 + 5),
+        ds2i::docid_range(n / 3 + 5, n - 7),
+        ds2i::docid_range(n / 2 + 3, n / 2 + 40),
+        ds2i::docid_range(n / 2 + 1, n / 2 + 1)
+    };
+    std::vector<uint64_t> odd_docs;
+    for (uint64_t docid = 1; docid < n; docid += 2) odd_docs.push_back(docid);
+    ds2i::bitmap_filter filter(n, odd_docs.begin(), odd_docs.end());
+    for (auto const& q: queries) {
+        for (auto const& range: ranges) {
+            uint64_t expected = and_q(base_index, q, range);
+            BOOST_REQUIRE_EQUAL(expected, and_q(index, q, range));
+            BOOST_REQUIRE_EQUAL(expected, and_freq_q(index, q, range));
+
+            expected = and_q(base_index, q, range, filter);
+            BOOST_REQUIRE_EQUAL(expected, and_q(index, q, range, filter));
+            BOOST_REQUIRE_EQUAL(expected, and_freq_q(index, q, range, filter));
+        }
+    }
+}
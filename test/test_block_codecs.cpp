@@ -44,3 +44,77 @@ BOOST_AUTO_TEST_CASE(block_codecs)
     test_block_codec<ds2i::interpolative_block>();
     test_block_codec<ds2i::qmx_block>();
 }
+
+// exhaustive search over the candidate b, as in FastPFor
+struct optpfor_reference : FastPFor::OPTPFor<4, FastPFor::Simple16<false>> {
+    uint32_t best_b(const uint32_t *in, uint32_t len) {
+        uint32_t b = 0;
+        uint32_t bsize = std::numeric_limits<uint32_t>::max();
+        const uint32_t mb = FastPFor::maxbits(in, in + len);
+        uint32_t i = 0;
+        while (mb > 28 + possLogs[i]) ++i;
+        for (; i < possLogs.size() && possLogs[i] <= mb; ++i) {
+            const uint32_t csize = tryB(possLogs[i], in, len);
+            if (csize <= bsize) {
+                b = possLogs[i];
+                bsize = csize;
+            }
+        }
+        return b;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(optpfor_best_b)
+{
+    ds2i::optpfor_block::codec_type codec;
+    codec.force_b = nullptr;
+    optpfor_reference reference;
+
+    std::mt19937 gen(12345);
+    const uint32_t len = ds2i::optpfor_block::block_size;
+    std::vector<uint32_t> values(len);
+    for (size_t tcase = 0; tcase < 5000; ++tcase) {
+        // mostly small values with a varying rate of large outliers
+        uint32_t small_bits = gen() % 16;
+        uint32_t large_bits = small_bits + gen() % (33 - small_bits);
+        uint32_t outlier_rate = 1 + gen() % 64;
+        for (auto& v: values) {
+            uint32_t bits = (gen() % outlier_rate) ? small_bits : large_bits;
+            v = bits ? uint32_t(gen() >> (32 - bits)) : 0;
+        }
+        BOOST_REQUIRE_EQUAL(reference.best_b(values.data(), len),
+                            codec.findBestB(values.data(), len));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(interpolative_coding)
+{
+    std::mt19937 gen(12345);
+    std::vector<size_t> sizes = {1, 2, 3, 4, 5, 7, 128, 1000, 100000};
+    for (auto n: sizes) {
+        for (size_t run_len: {1, 4, 1000}) {
+            // non-decreasing sequence with plateaus of equal values
+            std::vector<uint32_t> values(n);
+            uint32_t cur = 0;
+            for (size_t i = 0; i < n; ++i) {
+                if (gen() % run_len == 0) {
+                    cur += gen() % 10;
+                }
+                values[i] = cur;
+            }
+            uint32_t high = values.back() + 1;
+
+            std::vector<uint32_t> buf;
+            ds2i::bit_writer bw(buf);
+            bw.write_interpolative(values.data(), n, 0, high);
+
+            std::vector<uint32_t> decoded(n);
+            ds2i::bit_reader br(buf.data());
+            br.read_interpolative(decoded.data(), n, 0, high);
+
+            BOOST_REQUIRE_EQUAL(bw.size(), br.position());
+            BOOST_REQUIRE_EQUAL_COLLECTIONS(values.begin(), values.end(),
+                                            decoded.begin(), decoded.end());
+        }
+    }
+}
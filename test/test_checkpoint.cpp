@@ -0,0 +1,169 @@
+#define BOOST_TEST_MODULE checkpoint
+
+#include "succinct/test_common.hpp"
+
+#include "ds2i_config.hpp"
+#include "index_types.hpp"
+#include "checkpoint.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+#include <numeric>
+
+namespace ds2i { namespace test {
+
+    template <typename Builder>
+    void add_lists(Builder& builder, binary_freq_collection const& collection,
+                   size_t begin, size_t end)
+    {
+        size_t l = 0;
+        for (auto const& plist: collection) {
+            if (l >= begin && l < end) {
+                uint64_t freqs_sum = std::accumulate(plist.freqs.begin(),
+                                                     plist.freqs.end(), uint64_t(0));
+                builder.add_posting_list(plist.docs.size(), plist.docs.begin(),
+                                         plist.freqs.begin(), freqs_sum);
+            }
+            l += 1;
+        }
+    }
+
+    // Builds the index in three runs: the first is interrupted after a
+    // checkpoint and some lists that are not checkpointed (their data is
+    // written but not committed), the second is interrupted after
+    // another checkpoint, and the third completes the build
+    template <typename Index>
+    void test_resume()
+    {
+        binary_freq_collection collection(DS2I_SOURCE_DIR "/test/test_data/test_collection");
+        global_parameters params;
+        std::string dir = "temp_checkpoint";
+        mkdir(dir.c_str(), 0755);
+        std::remove((dir + "/state").c_str());
+
+        size_t num_lists = 0;
+        for (auto const& plist: collection) {
+            (void)plist;
+            num_lists += 1;
+        }
+        size_t first = num_lists / 3, second = 2 * num_lists / 3;
+
+        {
+            checkpoint ckpt(dir);
+            BOOST_REQUIRE(!ckpt.resumed());
+            typename Index::builder builder(collection.num_docs(), params);
+            builder.attach(ckpt, "index");
+            add_lists(builder, collection, 0, first);
+            builder.save(ckpt, "index");
+            ckpt.commit();
+
+            add_lists(builder, collection, first, second);
+            checkpoint uncommitted(ckpt);
+            builder.save(uncommitted, "index");
+        }
+
+        {
+            checkpoint ckpt(dir);
+            BOOST_REQUIRE(ckpt.resumed());
+            typename Index::builder builder(collection.num_docs(), params);
+            builder.attach(ckpt, "index");
+            add_lists(builder, collection, first, second);
+            builder.save(ckpt, "index");
+            ckpt.commit();
+        }
+
+        checkpoint ckpt(dir);
+        BOOST_REQUIRE(ckpt.resumed());
+        typename Index::builder builder(collection.num_docs(), params);
+        builder.attach(ckpt, "index");
+        add_lists(builder, collection, second, num_lists);
+        Index index;
+        builder.build(index);
+
+        {
+            // a run killed after the build, before the index is written,
+            // resumes from the data files mapped into index
+            checkpoint resumed(dir);
+            BOOST_REQUIRE(resumed.resumed());
+            typename Index::builder resumed_builder(collection.num_docs(), params);
+            resumed_builder.attach(resumed, "index");
+            add_lists(resumed_builder, collection, second, num_lists);
+            Index resumed_index;
+            resumed_builder.build(resumed_index);
+            BOOST_REQUIRE_EQUAL(num_lists, resumed_index.size());
+            for (size_t i = 0; i < num_lists; ++i) {
+                MY_REQUIRE_EQUAL(index[i].size(), resumed_index[i].size(),
+                                 "i = " << i);
+            }
+        }
+
+        ckpt.remove();
+        BOOST_REQUIRE(!std::ifstream((dir + "/state").c_str()));
+
+        BOOST_REQUIRE_EQUAL(num_lists, index.size());
+        size_t s = 0;
+        for (auto const& plist: collection) {
+            auto e = index[s];
+            BOOST_REQUIRE_EQUAL(plist.docs.size(), e.size());
+            for (size_t i = 0; i < e.size(); ++i, e.next()) {
+                MY_REQUIRE_EQUAL(*(plist.docs.begin() + i), e.docid(),
+                                 "s = " << s << " i = " << i);
+                MY_REQUIRE_EQUAL(*(plist.freqs.begin() + i), e.freq(),
+                                 "s = " << s << " i = " << i);
+            }
+            s += 1;
+        }
+        // the data files are removed with the checkpoint
+        BOOST_REQUIRE_EQUAL(0, rmdir(dir.c_str()));
+    }
+
+}}
+
+BOOST_AUTO_TEST_CASE(checkpoint_values)
+{
+    std::string dir = "temp_checkpoint";
+    mkdir(dir.c_str(), 0755);
+    std::remove((dir + "/state").c_str());
+
+    std::vector<uint64_t> v = {1, 2, 3};
+    {
+        ds2i::checkpoint ckpt(dir);
+        ckpt.set("lists", 42);
+        ckpt.set("type", std::string("opt"));
+        ckpt.save_vector("v", v);
+        ckpt.commit();
+        v.push_back(4);
+        ckpt.save_vector("v", v);
+        // not committed
+    }
+
+    ds2i::checkpoint ckpt(dir);
+    BOOST_REQUIRE(ckpt.resumed());
+    BOOST_REQUIRE_EQUAL(42, ckpt.get<uint64_t>("lists"));
+    BOOST_REQUIRE_EQUAL("opt", ckpt.get<std::string>("type"));
+    std::vector<uint64_t> loaded;
+    ckpt.load_vector("v", loaded);
+    BOOST_REQUIRE_EQUAL(3, loaded.size());
+    loaded.push_back(5);
+    ckpt.save_vector("v", loaded);
+    ckpt.commit();
+
+    ds2i::checkpoint resumed(dir);
+    resumed.load_vector("v", loaded);
+    BOOST_REQUIRE_EQUAL(4, loaded.size());
+    BOOST_REQUIRE_EQUAL(5, loaded[3]);
+    resumed.remove();
+    rmdir(dir.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(resume_freq_index)
+{
+    ds2i::test::test_resume<ds2i::opt_index>();
+}
+
+BOOST_AUTO_TEST_CASE(resume_block_freq_index)
+{
+    ds2i::test::test_resume<ds2i::block_optpfor_index>();
+}
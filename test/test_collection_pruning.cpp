@@ -0,0 +1,144 @@
+#define BOOST_TEST_MODULE collection_pruning
+
+#include "succinct/test_common.hpp"
+
+#include "ds2i_config.hpp"
+#include "binary_freq_collection.hpp"
+#include "binary_collection.hpp"
+#include "collection_pruning.hpp"
+#include "wand_data.hpp"
+
+namespace ds2i { namespace test {
+
+    struct collection_initialization {
+        collection_initialization()
+            : collection(DS2I_SOURCE_DIR "/test/test_data/test_collection")
+            , document_sizes(DS2I_SOURCE_DIR "/test/test_data/test_collection.sizes")
+            , wdata(document_sizes.begin()->begin(), collection.num_docs(), collection)
+        {}
+
+        // Checks that each pruned list is a nonempty subsequence of the
+        // original one, and returns the number of kept postings
+        uint64_t check_pruned(pruning_params const& params) const
+        {
+            collection_pruner<wand_data<>> pruner(collection, wdata, params);
+            pruner.write("temp_pruned");
+            binary_freq_collection pruned("temp_pruned");
+            BOOST_REQUIRE_EQUAL(collection.num_docs(), pruned.num_docs());
+
+            uint64_t kept = 0;
+            auto pruned_it = pruned.begin();
+            for (auto const& seq: collection) {
+                BOOST_REQUIRE(pruned_it != pruned.end());
+                auto const& pruned_seq = *pruned_it;
+                BOOST_REQUIRE(pruned_seq.docs.size() > 0);
+                BOOST_REQUIRE_EQUAL(pruned_seq.docs.size(), pruned_seq.freqs.size());
+                size_t j = 0;
+                for (size_t i = 0; i < seq.docs.size() && j < pruned_seq.docs.size(); ++i) {
+                    if (*(seq.docs.begin() + i) == *(pruned_seq.docs.begin() + j)) {
+                        BOOST_REQUIRE_EQUAL(*(seq.freqs.begin() + i),
+                                            *(pruned_seq.freqs.begin() + j));
+                        j += 1;
+                    }
+                }
+                BOOST_REQUIRE_EQUAL(j, pruned_seq.docs.size());
+                kept += j;
+                ++pruned_it;
+            }
+            BOOST_REQUIRE(pruned_it == pruned.end());
+            return kept;
+        }
+
+        binary_freq_collection collection;
+        binary_collection document_sizes;
+        wand_data<> wdata;
+    };
+
+    uint64_t num_postings(binary_freq_collection const& coll)
+    {
+        uint64_t postings = 0;
+        for (auto const& seq: coll) postings += seq.docs.size();
+        return postings;
+    }
+}}
+
+BOOST_FIXTURE_TEST_CASE(term_centric,
+                        ds2i::test::collection_initialization)
+{
+    ds2i::pruning_params params;
+    params.method = "term";
+    params.param = 0;
+    uint64_t postings = ds2i::test::num_postings(collection);
+    BOOST_REQUIRE_EQUAL(postings, check_pruned(params));
+
+    params.param = 0.5;
+    uint64_t kept = check_pruned(params);
+    BOOST_REQUIRE(kept < postings);
+    params.param = 0.8;
+    BOOST_REQUIRE(check_pruned(params) < kept);
+}
+
+BOOST_FIXTURE_TEST_CASE(document_centric,
+                        ds2i::test::collection_initialization)
+{
+    ds2i::pruning_params params;
+    params.method = "document";
+    params.param = 1;
+    uint64_t postings = ds2i::test::num_postings(collection);
+    BOOST_REQUIRE_EQUAL(postings, check_pruned(params));
+
+    // at least the fraction of each document is kept
+    params.param = 0.3;
+    uint64_t kept = check_pruned(params);
+    BOOST_REQUIRE(kept < postings);
+    BOOST_REQUIRE(kept >= uint64_t(0.3 * postings));
+}
+
+BOOST_FIXTURE_TEST_CASE(topk,
+                        ds2i::test::collection_initialization)
+{
+    ds2i::pruning_params params;
+    params.method = "topk";
+    params.param = 5;
+    check_pruned(params);
+
+    // the kept postings are the ones with the highest impact
+    ds2i::collection_pruner<ds2i::wand_data<>> pruner(collection, wdata, params);
+    std::vector<uint64_t> positions;
+    for (auto const& seq: collection) {
+        pruner.kept_positions(seq, positions);
+        uint64_t n = seq.docs.size();
+        BOOST_REQUIRE(positions.size() >= std::min<uint64_t>(n, 5));
+
+        float q_weight = ds2i::bm25::query_term_weight(1, n, collection.num_docs());
+        auto impact = [&](uint64_t i) {
+            return q_weight * ds2i::bm25::doc_term_weight
+                (*(seq.freqs.begin() + i), wdata.norm_len(*(seq.docs.begin() + i)));
+        };
+        float min_kept = std::numeric_limits<float>::max();
+        float max_dropped = 0;
+        size_t j = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            if (j < positions.size() && positions[j] == i) {
+                min_kept = std::min(min_kept, impact(i));
+                j += 1;
+            } else {
+                max_dropped = std::max(max_dropped, impact(i));
+            }
+        }
+        BOOST_REQUIRE(min_kept >= max_dropped);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(invalid_params,
+                        ds2i::test::collection_initialization)
+{
+    ds2i::pruning_params params;
+    params.method = "unknown";
+    BOOST_CHECK_THROW(ds2i::collection_pruner<ds2i::wand_data<>>(collection, wdata, params),
+                      std::invalid_argument);
+    params.method = "document";
+    params.param = 1.5;
+    BOOST_CHECK_THROW(ds2i::collection_pruner<ds2i::wand_data<>>(collection, wdata, params),
+                      std::invalid_argument);
+}
@@ -5,6 +5,7 @@
 #include "compact_elias_fano.hpp"
 #include <vector>
 #include <cstdlib>
+#include <algorithm>
 
 struct sequence_initialization {
     sequence_initialization()
@@ -97,3 +98,31 @@ BOOST_FIXTURE_TEST_CASE(compact_elias_fano_weakly_monotone,
     test_sequence(ds2i::compact_elias_fano(), params, universe, seq);
 }
 
+
+BOOST_FIXTURE_TEST_CASE(compact_elias_fano_bucket_skips,
+                        sequence_initialization)
+{
+    // lower bounds a few buckets ahead of the current position, which
+    // are skipped reading only the high bits
+    ds2i::compact_elias_fano::offsets of(0, universe, seq.size(), params);
+    ds2i::compact_elias_fano::enumerator r(bv, 0,
+                                           universe, seq.size(),
+                                           params);
+    for (size_t i = 0; i < seq.size(); i += 1 + rand() % 8) {
+        for (uint64_t high_diff = 0; high_diff <= 10; ++high_diff) {
+            uint64_t lower_bound = seq[i] + 1 +
+                (high_diff << of.lower_bits) + rand() % (1 << of.lower_bits);
+            size_t exp_pos = std::lower_bound(seq.begin(), seq.end(), lower_bound)
+                - seq.begin();
+            uint64_t exp_value = exp_pos < seq.size() ? seq[exp_pos] : universe;
+
+            auto rr = r;
+            rr.move(i);
+            auto val = rr.next_geq(lower_bound);
+            MY_REQUIRE_EQUAL(exp_pos, val.first,
+                             "i = " << i << " lower_bound = " << lower_bound);
+            MY_REQUIRE_EQUAL(exp_value, val.second,
+                             "i = " << i << " lower_bound = " << lower_bound);
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#define BOOST_TEST_MODULE dec_time_prediction
+
+#include "succinct/test_common.hpp"
+#include "dec_time_prediction.hpp"
+#include <vector>
+#include <random>
+
+BOOST_AUTO_TEST_CASE(predictor_training)
+{
+    using namespace ds2i::time_prediction;
+
+    std::mt19937 gen(1729);
+    std::uniform_real_distribution<float> size_dis(16, 512);
+    std::uniform_int_distribution<int> b_dis(0, 20);
+    std::uniform_real_distribution<float> noise_dis(-0.5, 0.5);
+
+    std::vector<training_sample> samples(20000);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        auto& s = samples[i];
+        s.features[feature_type::n] = 128;
+        s.features[feature_type::size] = size_dis(gen);
+        s.features[feature_type::max_b] = b_dis(gen);
+        s.features[feature_type::entropy] = s.features[feature_type::size];
+        s.time = 30 + 0.25 * s.features[feature_type::size]
+            + 2 * s.features[feature_type::max_b] + noise_dis(gen);
+        // a few outliers, which the Huber loss should mostly ignore
+        if (i % 50 == 0) s.time *= 10;
+    }
+
+    for (size_t threads: {1, 4}) {
+        predictor pred = train_predictor(samples, 0, threads);
+        BOOST_CHECK_CLOSE(30.0, pred.bias(), 2);
+        BOOST_CHECK_CLOSE(0.25, pred[feature_type::size], 2);
+        BOOST_CHECK_CLOSE(2.0, pred[feature_type::max_b], 2);
+        // unused features
+        BOOST_CHECK_EQUAL(0, pred[feature_type::n]);
+        BOOST_CHECK_EQUAL(0, pred[feature_type::entropy]);
+        // weights are non-negative
+        for (size_t j = 0; j < num_features; ++j) {
+            BOOST_CHECK_GE(pred[(feature_type)j], 0);
+        }
+    }
+
+    // the penalty shrinks the weights
+    predictor unpenalized = train_predictor(samples, 0, 4);
+    predictor penalized = train_predictor(samples, 1, 4);
+    BOOST_CHECK_LT(penalized[feature_type::max_b], unpenalized[feature_type::max_b]);
+}
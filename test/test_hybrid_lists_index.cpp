@@ -0,0 +1,105 @@
+#define BOOST_TEST_MODULE hybrid_lists_index
+
+#include "test_generic_sequence.hpp"
+
+#include "index_types.hpp"
+#include <succinct/mapper.hpp>
+
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+#include <numeric>
+
+// second_ratio is the fraction of lists explicitly stored in the second
+// representation; a negative value uses the builder's default choice
+template <typename CollectionType>
+void test_hybrid_lists_index(double second_ratio)
+{
+    ds2i::global_parameters params;
+    uint64_t universe = 20000;
+    typedef CollectionType collection_type;
+    typename collection_type::builder b(universe, params);
+
+    typedef std::vector<uint64_t> vec_type;
+    std::vector<std::pair<vec_type, vec_type>> posting_lists(100);
+    std::vector<typename collection_type::representation> reprs;
+    size_t num_second = 0;
+    for (auto& plist: posting_lists) {
+        double avg_gap = 1.1 + double(rand()) / RAND_MAX * 100;
+        uint64_t n = uint64_t(universe / avg_gap);
+
+        plist.first = random_sequence(universe, n, true);
+        plist.second.resize(n);
+        std::generate(plist.second.begin(), plist.second.end(),
+                      []() { return (rand() % 256) + 1; });
+        uint64_t freqs_sum = std::accumulate(plist.second.begin(),
+                                             plist.second.end(), uint64_t(0));
+
+        if (second_ratio < 0) {
+            reprs.push_back(n >= collection_type::default_length_threshold
+                            ? collection_type::second_representation
+                            : collection_type::first_representation);
+            b.add_posting_list(n, plist.first.begin(),
+                               plist.second.begin(), freqs_sum);
+        } else {
+            reprs.push_back(double(rand()) / RAND_MAX < second_ratio
+                            ? collection_type::second_representation
+                            : collection_type::first_representation);
+            b.add_posting_list(n, plist.first.begin(),
+                               plist.second.begin(), freqs_sum, reprs.back());
+        }
+        if (reprs.back() == collection_type::second_representation) {
+            num_second += 1;
+        }
+    }
+
+    {
+        collection_type coll;
+        b.build(coll);
+        BOOST_REQUIRE_EQUAL(num_second, coll.num_second_lists());
+        succinct::mapper::freeze(coll, "temp.bin");
+    }
+
+    {
+        collection_type coll;
+        boost::iostreams::mapped_file_source m("temp.bin");
+        succinct::mapper::map(coll, m);
+        BOOST_REQUIRE_EQUAL(posting_lists.size(), coll.size());
+
+        for (size_t i = 0; i < posting_lists.size(); ++i) {
+            auto const& plist = posting_lists[i];
+            auto doc_enum = coll[i];
+            BOOST_REQUIRE_EQUAL(plist.first.size(), doc_enum.size());
+            BOOST_REQUIRE_EQUAL(reprs[i], doc_enum.repr());
+            for (size_t p = 0; p < plist.first.size(); ++p, doc_enum.next()) {
+                MY_REQUIRE_EQUAL(plist.first[p], doc_enum.docid(),
+                                 "i = " << i << " p = " << p);
+                MY_REQUIRE_EQUAL(plist.second[p], doc_enum.freq(),
+                                 "i = " << i << " p = " << p);
+            }
+            BOOST_REQUIRE_EQUAL(coll.num_docs(), doc_enum.docid());
+
+            // next_geq on every docid and past the end
+            doc_enum.reset();
+            for (size_t p = 0; p < plist.first.size(); ++p) {
+                doc_enum.next_geq(plist.first[p]);
+                MY_REQUIRE_EQUAL(p, doc_enum.position(),
+                                 "i = " << i << " p = " << p);
+            }
+            doc_enum.next_geq(plist.first.back() + 1);
+            BOOST_REQUIRE_EQUAL(coll.num_docs(), doc_enum.docid());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(hybrid_lists_index)
+{
+    typedef ds2i::hybrid_lists_index<ds2i::opt_index,
+                                     ds2i::block_optpfor_index> opt_optpfor_index;
+    test_hybrid_lists_index<opt_optpfor_index>(-1);
+    test_hybrid_lists_index<opt_optpfor_index>(0.5);
+    // one of the two indexes is empty
+    test_hybrid_lists_index<opt_optpfor_index>(0);
+    test_hybrid_lists_index<opt_optpfor_index>(1);
+    test_hybrid_lists_index<ds2i::hybrid_index>(0.5);
+}
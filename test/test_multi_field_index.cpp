@@ -0,0 +1,221 @@
+#define BOOST_TEST_MODULE multi_field_index
+
+#include "test_generic_sequence.hpp"
+#include <boost/test/floating_point_comparison.hpp>
+
+#include "ds2i_config.hpp"
+#include "index_types.hpp"
+#include "multi_field_wand_data.hpp"
+#include "queries.hpp"
+#include <succinct/mapper.hpp>
+
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+#include <numeric>
+
+template <typename CollectionType>
+void test_multi_field_index(uint64_t num_fields)
+{
+    ds2i::global_parameters params;
+    uint64_t universe = 20000;
+    typedef CollectionType collection_type;
+    typename collection_type::builder b(universe, num_fields, params);
+
+    typedef std::vector<uint64_t> vec_type;
+    struct posting_list {
+        vec_type docs, freqs, fields;
+    };
+    std::vector<posting_list> posting_lists(100);
+    for (auto& plist: posting_lists) {
+        double avg_gap = 1.1 + double(rand()) / RAND_MAX * 100;
+        uint64_t n = uint64_t(universe / avg_gap);
+
+        plist.docs = random_sequence(universe, n, true);
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t freq = 0;
+            for (uint64_t f = 0; f < num_fields; ++f) {
+                plist.fields.push_back(rand() % 4);
+                freq += plist.fields.back();
+            }
+            if (!freq) {
+                plist.fields[i * num_fields + rand() % num_fields] = 1;
+                freq = 1;
+            }
+            plist.freqs.push_back(freq);
+        }
+        uint64_t freqs_sum = std::accumulate(plist.freqs.begin(),
+                                             plist.freqs.end(), uint64_t(0));
+        b.add_posting_list(n, plist.docs.begin(), plist.freqs.begin(),
+                           freqs_sum, plist.fields.begin());
+    }
+
+    {
+        collection_type coll;
+        b.build(coll);
+        succinct::mapper::freeze(coll, "temp.bin");
+    }
+
+    {
+        collection_type coll;
+        boost::iostreams::mapped_file_source m("temp.bin");
+        succinct::mapper::map(coll, m);
+        BOOST_REQUIRE_EQUAL(posting_lists.size(), coll.size());
+        BOOST_REQUIRE_EQUAL(num_fields, coll.num_fields());
+
+        std::vector<uint64_t> freqs(num_fields);
+        for (size_t i = 0; i < posting_lists.size(); ++i) {
+            auto const& plist = posting_lists[i];
+            auto doc_enum = coll[i];
+            BOOST_REQUIRE_EQUAL(plist.docs.size(), doc_enum.size());
+            for (size_t p = 0; p < plist.docs.size(); ++p, doc_enum.next()) {
+                MY_REQUIRE_EQUAL(plist.docs[p], doc_enum.docid(),
+                                 "i = " << i << " p = " << p);
+                MY_REQUIRE_EQUAL(plist.freqs[p], doc_enum.freq(),
+                                 "i = " << i << " p = " << p);
+                doc_enum.field_freqs(freqs.data());
+                for (uint64_t f = 0; f < num_fields; ++f) {
+                    MY_REQUIRE_EQUAL(plist.fields[p * num_fields + f], freqs[f],
+                                     "i = " << i << " p = " << p << " f = " << f);
+                }
+            }
+            BOOST_REQUIRE_EQUAL(coll.num_docs(), doc_enum.docid());
+
+            // field frequencies after skipping
+            doc_enum.reset();
+            for (size_t p = 0; p < plist.docs.size(); p += 1 + rand() % 16) {
+                doc_enum.next_geq(plist.docs[p]);
+                doc_enum.field_freqs(freqs.data());
+                MY_REQUIRE_EQUAL(plist.fields[p * num_fields + num_fields - 1],
+                                 freqs[num_fields - 1],
+                                 "i = " << i << " p = " << p);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(multi_field_index)
+{
+    test_multi_field_index<ds2i::multi_field_opt_index>(3);
+    test_multi_field_index<ds2i::multi_field_opt_index>(1);
+    test_multi_field_index<ds2i::multi_field_block_optpfor_index>(3);
+}
+
+namespace ds2i { namespace test {
+
+    // Splits the test collection into fields, and scores it with BM25F
+    struct multi_field_initialization {
+
+        typedef multi_field_index<single_index> index_type;
+
+        struct sequence {
+            std::vector<uint32_t> docs, fields;
+        };
+
+        multi_field_initialization()
+            : collection(DS2I_SOURCE_DIR "/test/test_data/test_collection")
+            , document_sizes(DS2I_SOURCE_DIR "/test/test_data/test_collection.sizes")
+            , wdata(document_sizes.begin()->begin(), collection.num_docs(), collection)
+        {
+            term_id_vec q;
+            std::ifstream qfile("test_data/queries");
+            while (read_query(q, qfile)) queries.push_back(q);
+        }
+
+        void build(uint64_t num_fields, std::vector<float> const& field_weights,
+                   std::vector<float> const& field_b)
+        {
+            uint64_t num_docs = collection.num_docs();
+            index_type::builder builder(num_docs, num_fields, params);
+            std::vector<sequence> fields_coll;
+            for (auto const& plist: collection) {
+                fields_coll.emplace_back();
+                sequence& seq = fields_coll.back();
+                seq.docs.assign(plist.docs.begin(), plist.docs.end());
+                for (size_t i = 0; i < plist.docs.size(); ++i) {
+                    // the first field gets about a third of the occurrences
+                    uint32_t freq = *(plist.freqs.begin() + i);
+                    uint32_t first = num_fields > 1 ? (freq + seq.docs[i] % 3) / 3 : freq;
+                    seq.fields.push_back(first);
+                    if (num_fields > 1) seq.fields.push_back(freq - first);
+                }
+                uint64_t freqs_sum = std::accumulate(plist.freqs.begin(),
+                                                     plist.freqs.end(), uint64_t(0));
+                builder.add_posting_list(plist.docs.size(), plist.docs.begin(),
+                                         plist.freqs.begin(), freqs_sum,
+                                         seq.fields.begin());
+            }
+            index_type().swap(index);
+            builder.build(index);
+
+            std::vector<std::vector<uint32_t>> lengths(num_fields);
+            uint32_t const* sizes = document_sizes.begin()->begin();
+            for (size_t d = 0; d < num_docs; ++d) {
+                uint32_t first = num_fields > 1 ? sizes[d] / 3 : sizes[d];
+                lengths[0].push_back(first);
+                if (num_fields > 1) lengths[1].push_back(sizes[d] - first);
+            }
+            std::vector<std::vector<uint32_t>::const_iterator> field_lengths;
+            for (auto const& l: lengths) field_lengths.push_back(l.begin());
+            multi_field_wand_data<>(field_lengths, num_docs, fields_coll,
+                                    field_weights, field_b).swap(mf_wdata);
+        }
+
+        template <typename QueryOp>
+        void test_against_or(QueryOp& op_q) const
+        {
+            basic_ranked_or_query<multi_field_wand_data<>> or_q(mf_wdata, 10);
+
+            for (auto const& q: queries) {
+                or_q(index, q);
+                op_q(index, q);
+                BOOST_REQUIRE_EQUAL(or_q.topk().size(), op_q.topk().size());
+                for (size_t i = 0; i < or_q.topk().size(); ++i) {
+                    BOOST_REQUIRE_CLOSE(or_q.topk()[i].first, op_q.topk()[i].first, 0.1); // tolerance is % relative
+                }
+            }
+        }
+
+        global_parameters params;
+        binary_freq_collection collection;
+        binary_collection document_sizes;
+        index_type index;
+        std::vector<term_id_vec> queries;
+        wand_data<> wdata;
+        multi_field_wand_data<> mf_wdata;
+    };
+
+}}
+
+BOOST_FIXTURE_TEST_CASE(bm25f_single_field,
+                        ds2i::test::multi_field_initialization)
+{
+    // with a single field BM25F is BM25
+    build(1, {1}, {ds2i::bm25::b});
+    ds2i::ranked_or_query or_q(wdata, 10);
+    ds2i::basic_ranked_or_query<ds2i::multi_field_wand_data<>> bm25f_q(mf_wdata, 10);
+    for (auto const& q: queries) {
+        or_q(index, q);
+        bm25f_q(index, q);
+        BOOST_REQUIRE_EQUAL(or_q.topk().size(), bm25f_q.topk().size());
+        for (size_t i = 0; i < or_q.topk().size(); ++i) {
+            BOOST_REQUIRE_CLOSE(or_q.topk()[i].first, bm25f_q.topk()[i].first, 0.1);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(bm25f_wand,
+                        ds2i::test::multi_field_initialization)
+{
+    build(2, {3, 1}, {0.6, 0.75});
+    ds2i::basic_wand_query<ds2i::multi_field_wand_data<>> wand_q(mf_wdata, 10);
+    test_against_or(wand_q);
+}
+
+BOOST_FIXTURE_TEST_CASE(bm25f_maxscore,
+                        ds2i::test::multi_field_initialization)
+{
+    build(2, {3, 1}, {0.6, 0.75});
+    ds2i::basic_maxscore_query<ds2i::multi_field_wand_data<>> maxscore_q(mf_wdata, 10);
+    test_against_or(maxscore_q);
+}
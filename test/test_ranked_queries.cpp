@@ -2,6 +2,7 @@
 
 #include "succinct/test_common.hpp"
 #include <boost/test/floating_point_comparison.hpp>
+#include <limits>
 
 #include "ds2i_config.hpp"
 #include "index_types.hpp"
@@ -42,14 +43,14 @@ namespace ds2i { namespace test {
         template <typename QueryOp>
         void test_against_or(QueryOp& op_q) const
         {
-            ranked_or_query or_q(wdata, 10);
+            ranked_or_query or_q(wdata, 10, std::numeric_limits<size_t>::max());
 
             for (auto const& q: queries) {
                 or_q(index, q);
                 op_q(index, q);
                 BOOST_REQUIRE_EQUAL(or_q.topk().size(), op_q.topk().size());
                 for (size_t i = 0; i < or_q.topk().size(); ++i) {
-                    BOOST_REQUIRE_CLOSE(or_q.topk()[i], op_q.topk()[i], 0.1); // tolerance is % relative
+                    BOOST_REQUIRE_CLOSE(or_q.topk()[i].first, op_q.topk()[i].first, 0.1); // tolerance is % relative
                 }
             }
         }
@@ -73,3 +74,275 @@ BOOST_FIXTURE_TEST_CASE(maxscore,
     ds2i::maxscore_query maxscore_q(wdata, 10);
     test_against_or(maxscore_q);
 }
+
+BOOST_FIXTURE_TEST_CASE(heap_or,
+                        ds2i::test::index_initialization)
+{
+    // the docid heap is used on all the queries
+    ds2i::ranked_or_query heap_q(wdata, 10, 1);
+    test_against_or(heap_q);
+
+    ds2i::or_query<true> or_q(std::numeric_limits<size_t>::max());
+    ds2i::or_query<true> heap_or_q(1);
+    for (auto const& q: queries) {
+        BOOST_REQUIRE_EQUAL(or_q(index, q), heap_or_q(index, q));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(large_k,
+                        ds2i::test::index_initialization)
+{
+    // the top-k entries are buffered instead of kept in a heap
+    uint64_t k = ds2i::topk_queue::buffered_threshold + 10;
+    ds2i::ranked_or_query or_q(wdata, k, std::numeric_limits<size_t>::max());
+    ds2i::wand_query wand_q(wdata, k);
+    ds2i::maxscore_query maxscore_q(wdata, k);
+    for (auto const& q: queries) {
+        or_q(index, q);
+        wand_q(index, q);
+        maxscore_q(index, q);
+        BOOST_REQUIRE_EQUAL(or_q.topk().size(), wand_q.topk().size());
+        BOOST_REQUIRE_EQUAL(or_q.topk().size(), maxscore_q.topk().size());
+        for (size_t i = 0; i < or_q.topk().size(); ++i) {
+            BOOST_REQUIRE_CLOSE(or_q.topk()[i].first, wand_q.topk()[i].first, 0.1);
+            BOOST_REQUIRE_CLOSE(or_q.topk()[i].first, maxscore_q.topk()[i].first, 0.1);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(topk_queue)
+{
+    for (uint64_t k: {uint64_t(10), ds2i::topk_queue::buffered_threshold + 10}) {
+        ds2i::topk_queue q(k);
+        std::vector<float> scores;
+        for (size_t i = 0; i < 20 * k; ++i) {
+            scores.push_back(float(rand() % 100000));
+            q.insert(scores.back(), i);
+        }
+        q.finalize();
+        std::sort(scores.begin(), scores.end(), std::greater<float>());
+        BOOST_REQUIRE_EQUAL(k, q.topk().size());
+        for (size_t i = 0; i < k; ++i) {
+            BOOST_REQUIRE_EQUAL(scores[i], q.topk()[i].first);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(docid_range,
+                        ds2i::test::index_initialization)
+{
+    using ds2i::docid_range;
+    uint64_t n = index.num_docs();
+    // a partition of the docids, plus a range inside a single word
+    std::vector<docid_range> ranges = {
+        docid_range(0, n / 3),
+        docid_range(n / 3, 2 * n / 3),
+        docid_range(2 * n / 3)
+    };
+    docid_range small_range(n / 2 + 3, n / 2 + 40);
+
+    ds2i::ranked_or_query or_q(wdata, 10, std::numeric_limits<size_t>::max());
+    ds2i::ranked_or_query heap_q(wdata, 10, 1);
+    ds2i::wand_query wand_q(wdata, 10);
+    ds2i::maxscore_query maxscore_q(wdata, 10);
+    ds2i::and_query<true> and_q;
+    ds2i::or_query<false> count_or_q;
+
+    for (auto const& q: queries) {
+        uint64_t and_results = 0, or_results = 0;
+        auto all_ranges = ranges;
+        all_ranges.push_back(small_range);
+        for (auto const& range: all_ranges) {
+            or_q(index, q, range);
+            for (auto const& entry: or_q.topk()) {
+                BOOST_REQUIRE(entry.second >= range.begin);
+                BOOST_REQUIRE(entry.second < range.end);
+            }
+
+            heap_q(index, q, range);
+            wand_q(index, q, range);
+            maxscore_q(index, q, range);
+            BOOST_REQUIRE_EQUAL(or_q.topk().size(), heap_q.topk().size());
+            BOOST_REQUIRE_EQUAL(or_q.topk().size(), wand_q.topk().size());
+            BOOST_REQUIRE_EQUAL(or_q.topk().size(), maxscore_q.topk().size());
+            for (size_t i = 0; i < or_q.topk().size(); ++i) {
+                BOOST_REQUIRE_CLOSE(or_q.topk()[i].first, heap_q.topk()[i].first, 0.1);
+                BOOST_REQUIRE_CLOSE(or_q.topk()[i].first, wand_q.topk()[i].first, 0.1);
+                BOOST_REQUIRE_CLOSE(or_q.topk()[i].first, maxscore_q.topk()[i].first, 0.1);
+            }
+
+            if (&range != &all_ranges.back()) {
+                and_results += and_q(index, q, range);
+                or_results += count_or_q(index, q, range);
+            }
+        }
+
+        // the results over the partition add up to the unrestricted ones
+        BOOST_REQUIRE_EQUAL(and_q(index, q), and_results);
+        BOOST_REQUIRE_EQUAL(count_or_q(index, q), or_results);
+    }
+}
+
+namespace {
+
+    template <typename Filter>
+    void test_filter(ds2i::test::index_initialization const& data,
+                     Filter const& filter, std::vector<bool> const& allowed)
+    {
+        using namespace ds2i;
+        uint64_t n = data.index.num_docs();
+        // the unfiltered results, all of them
+        ranked_or_query all_or_q(data.wdata, n, std::numeric_limits<size_t>::max());
+        ranked_and_query all_and_q(data.wdata, n);
+
+        ranked_or_query or_q(data.wdata, 10, std::numeric_limits<size_t>::max());
+        ranked_or_query heap_q(data.wdata, 10, 1);
+        wand_query wand_q(data.wdata, 10);
+        maxscore_query maxscore_q(data.wdata, 10);
+        ranked_and_query ranked_and_q(data.wdata, 10);
+        and_query<false> and_q;
+        or_query<false> count_or_q(std::numeric_limits<size_t>::max());
+        or_query<true> heap_or_q(1);
+        ds2i::docid_range all_docs;
+
+        for (auto const& q: data.queries) {
+            all_or_q(data.index, q);
+            all_and_q(data.index, q);
+            std::vector<float> expected_or, expected_and;
+            for (auto const& entry: all_or_q.topk()) {
+                if (allowed[entry.second]) expected_or.push_back(entry.first);
+            }
+            for (auto const& entry: all_and_q.topk()) {
+                if (allowed[entry.second]) expected_and.push_back(entry.first);
+            }
+
+            BOOST_REQUIRE_EQUAL(expected_and.size(),
+                                and_q(data.index, q, all_docs, filter));
+            BOOST_REQUIRE_EQUAL(expected_or.size(),
+                                count_or_q(data.index, q, all_docs, filter));
+            BOOST_REQUIRE_EQUAL(expected_or.size(),
+                                heap_or_q(data.index, q, all_docs, filter));
+
+            expected_or.resize(std::min<size_t>(expected_or.size(), 10));
+            expected_and.resize(std::min<size_t>(expected_and.size(), 10));
+            ranked_and_q(data.index, q, all_docs, filter);
+            BOOST_REQUIRE_EQUAL(expected_and.size(), ranked_and_q.topk().size());
+            for (size_t i = 0; i < expected_and.size(); ++i) {
+                BOOST_REQUIRE_CLOSE(expected_and[i], ranked_and_q.topk()[i].first, 0.1);
+            }
+
+            or_q(data.index, q, all_docs, filter);
+            heap_q(data.index, q, all_docs, filter);
+            wand_q(data.index, q, all_docs, filter);
+            maxscore_q(data.index, q, all_docs, filter);
+            for (auto op_topk: {&or_q.topk(), &heap_q.topk(),
+                        &wand_q.topk(), &maxscore_q.topk()}) {
+                BOOST_REQUIRE_EQUAL(expected_or.size(), op_topk->size());
+                for (size_t i = 0; i < expected_or.size(); ++i) {
+                    BOOST_REQUIRE(allowed[(*op_topk)[i].second]);
+                    BOOST_REQUIRE_CLOSE(expected_or[i], (*op_topk)[i].first, 0.1);
+                }
+            }
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(docid_filter,
+                        ds2i::test::index_initialization)
+{
+    uint64_t n = index.num_docs();
+    // a dense set, and a sparse one
+    std::vector<uint64_t> dense, sparse;
+    std::vector<bool> in_dense(n), in_sparse(n);
+    for (uint64_t docid = 0; docid < n; ++docid) {
+        uint64_t h = docid * 0x9E3779B97F4A7C15ULL >> 60;
+        if (h % 4 != 0) {
+            dense.push_back(docid);
+            in_dense[docid] = true;
+        }
+        if (h == 0 || docid == n - 1) {
+            sparse.push_back(docid);
+            in_sparse[docid] = true;
+        }
+    }
+    std::vector<bool> not_in_dense(n), not_in_sparse(n);
+    for (uint64_t docid = 0; docid < n; ++docid) {
+        not_in_dense[docid] = !in_dense[docid];
+        not_in_sparse[docid] = !in_sparse[docid];
+    }
+
+    test_filter(*this, ds2i::bitmap_filter(n, dense.begin(), dense.end()), in_dense);
+    test_filter(*this, ds2i::bitmap_filter(n, dense.begin(), dense.end(), true),
+                not_in_dense);
+    test_filter(*this, ds2i::ef_filter(n, sparse.begin(), sparse.end()), in_sparse);
+    test_filter(*this, ds2i::ef_filter(n, sparse.begin(), sparse.end(), true),
+                not_in_sparse);
+}
+
+BOOST_FIXTURE_TEST_CASE(static_rank_and,
+                        ds2i::test::index_initialization)
+{
+    uint64_t n = index.num_docs();
+    // non-increasing static scores, with some ties
+    std::vector<float> static_scores(n);
+    float cur = 1;
+    for (uint64_t docid = 0; docid < n; ++docid) {
+        if (docid * 0x9E3779B97F4A7C15ULL >> 62) cur *= 0.999f;
+        static_scores[docid] = cur;
+    }
+
+    ds2i::ranked_and_query all_and_q(wdata, n);
+    for (float static_weight: {0.f, 0.5f, 5.f, 100.f}) {
+        ds2i::static_rank_and_query static_q(wdata, 10, static_scores, static_weight);
+        for (auto const& q: queries) {
+            all_and_q(index, q);
+            std::vector<float> expected;
+            for (auto const& entry: all_and_q.topk()) {
+                expected.push_back(entry.first + static_weight * static_scores[entry.second]);
+            }
+            std::sort(expected.rbegin(), expected.rend());
+            expected.resize(std::min<size_t>(expected.size(), 10));
+
+            static_q(index, q);
+            BOOST_REQUIRE_EQUAL(expected.size(), static_q.topk().size());
+            for (size_t i = 0; i < expected.size(); ++i) {
+                BOOST_REQUIRE_CLOSE(expected[i], static_q.topk()[i].first, 0.1);
+            }
+        }
+    }
+
+    std::reverse(static_scores.begin(), static_scores.end());
+    BOOST_CHECK_THROW(ds2i::static_rank_and_query(wdata, 10, static_scores, 1),
+                      std::invalid_argument);
+}
+
+BOOST_FIXTURE_TEST_CASE(threshold_factor,
+                        ds2i::test::index_initialization)
+{
+    ds2i::wand_query exact_q(wdata, 10, 1);
+    for (float factor: {1.f, 1.2f, 2.f}) {
+        ds2i::wand_query wand_q(wdata, 10, factor);
+        ds2i::maxscore_query maxscore_q(wdata, 10, factor);
+        if (factor == 1) {
+            test_against_or(wand_q);
+            test_against_or(maxscore_q);
+            continue;
+        }
+        // the approximate top-k cannot be better than the exact one
+        for (auto const& q: queries) {
+            exact_q(index, q);
+            wand_q(index, q);
+            maxscore_q(index, q);
+            BOOST_REQUIRE_EQUAL(exact_q.topk().size(), wand_q.topk().size());
+            BOOST_REQUIRE_EQUAL(exact_q.topk().size(), maxscore_q.topk().size());
+            for (size_t i = 0; i < exact_q.topk().size(); ++i) {
+                float exact = exact_q.topk()[i].first * 1.001f;
+                BOOST_REQUIRE_LE(wand_q.topk()[i].first, exact);
+                BOOST_REQUIRE_LE(maxscore_q.topk()[i].first, exact);
+            }
+        }
+    }
+
+    BOOST_CHECK_THROW(ds2i::wand_query(wdata, 10, 0.5), std::invalid_argument);
+    BOOST_CHECK_THROW(ds2i::maxscore_query(wdata, 10, 0.5), std::invalid_argument);
+}
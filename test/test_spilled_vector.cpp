@@ -0,0 +1,56 @@
+#define BOOST_TEST_MODULE spilled_vector
+
+#include "test_generic_sequence.hpp"
+
+#include "spilled_vector.hpp"
+#include <succinct/bit_vector.hpp>
+#include <succinct/mapper.hpp>
+
+#include <vector>
+#include <cstdlib>
+
+BOOST_AUTO_TEST_CASE(spilled_vector)
+{
+    std::vector<uint8_t> v;
+    succinct::mapper::mappable_vector<uint8_t> mv;
+    ds2i::spilled_vector<uint8_t>::mapping_type mapping;
+    {
+        ds2i::spilled_vector<uint8_t> sv("temp.spill");
+        for (size_t i = 0; i < 1000; ++i) {
+            std::vector<uint8_t> chunk(rand() % 100);
+            for (auto& b: chunk) b = rand();
+            v.insert(v.end(), chunk.begin(), chunk.end());
+            sv.append(chunk);
+        }
+        BOOST_REQUIRE_EQUAL(v.size(), sv.size());
+        mapping = sv.map(mv);
+    }
+    // the file is removed once mapped, and the mapping outlives the
+    // spilled_vector
+    BOOST_REQUIRE(!std::ifstream("temp.spill"));
+    BOOST_REQUIRE_EQUAL(v.size(), mv.size());
+    for (size_t i = 0; i < v.size(); ++i) {
+        MY_REQUIRE_EQUAL(v[i], mv[i], "i = " << i);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(spilled_bit_vector)
+{
+    succinct::bit_vector_builder bvb;
+    for (size_t i = 0; i < 100000; ++i) {
+        bvb.push_back(rand() % 2);
+    }
+    bvb.append_bits(1, 13); // last word incomplete
+    auto const& words = bvb.move_bits();
+
+    ds2i::spilled_vector<uint64_t> sv("temp.spill", 1);
+    sv.append(words.data(), words.size());
+    succinct::bit_vector bv;
+    auto mapping = sv.map(bv, {bvb.size()});
+
+    succinct::bit_vector expected(&bvb);
+    BOOST_REQUIRE_EQUAL(expected.size(), bv.size());
+    for (size_t i = 0; i < bv.size(); ++i) {
+        MY_REQUIRE_EQUAL(expected[i], bv[i], "i = " << i);
+    }
+}
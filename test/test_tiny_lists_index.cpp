@@ -0,0 +1,87 @@
+#define BOOST_TEST_MODULE tiny_lists_index
+
+#include "test_generic_sequence.hpp"
+
+#include "index_types.hpp"
+#include <succinct/mapper.hpp>
+
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+
+template <typename BaseIndex>
+void test_tiny_lists_index(bool with_long_lists)
+{
+    ds2i::global_parameters params;
+    uint64_t universe = 20000;
+    typedef ds2i::tiny_lists_index<BaseIndex> collection_type;
+    typename collection_type::builder b(universe, params);
+
+    typedef std::vector<uint64_t> vec_type;
+    std::vector<std::pair<vec_type, vec_type>> posting_lists(100);
+    size_t num_tiny = 0;
+    for (auto& plist: posting_lists) {
+        uint64_t n = 1 + rand() % collection_type::max_tiny_size;
+        if (with_long_lists && rand() % 3 == 0) {
+            double avg_gap = 1.1 + double(rand()) / RAND_MAX * 10;
+            n = uint64_t(universe / avg_gap);
+        }
+        if (n <= collection_type::max_tiny_size) {
+            num_tiny += 1;
+        }
+        plist.first = random_sequence(universe, n, true);
+        plist.second.resize(n);
+        std::generate(plist.second.begin(), plist.second.end(),
+                      []() { return (rand() % 256) + 1; });
+
+        b.add_posting_list(n, plist.first.begin(),
+                           plist.second.begin(), 0);
+    }
+
+    {
+        collection_type coll;
+        b.build(coll);
+        BOOST_REQUIRE_EQUAL(num_tiny, coll.num_tiny_lists());
+        succinct::mapper::freeze(coll, "temp.bin");
+    }
+
+    {
+        collection_type coll;
+        boost::iostreams::mapped_file_source m("temp.bin");
+        succinct::mapper::map(coll, m);
+        BOOST_REQUIRE_EQUAL(posting_lists.size(), coll.size());
+
+        for (size_t i = 0; i < posting_lists.size(); ++i) {
+            auto const& plist = posting_lists[i];
+            auto doc_enum = coll[i];
+            BOOST_REQUIRE_EQUAL(plist.first.size(), doc_enum.size());
+            BOOST_REQUIRE_EQUAL(plist.first.size() <= collection_type::max_tiny_size,
+                                doc_enum.is_tiny());
+            for (size_t p = 0; p < plist.first.size(); ++p, doc_enum.next()) {
+                MY_REQUIRE_EQUAL(plist.first[p], doc_enum.docid(),
+                                 "i = " << i << " p = " << p);
+                MY_REQUIRE_EQUAL(plist.second[p], doc_enum.freq(),
+                                 "i = " << i << " p = " << p);
+            }
+            BOOST_REQUIRE_EQUAL(coll.num_docs(), doc_enum.docid());
+
+            // next_geq on every docid and past the end
+            doc_enum.reset();
+            for (size_t p = 0; p < plist.first.size(); ++p) {
+                doc_enum.next_geq(plist.first[p]);
+                MY_REQUIRE_EQUAL(p, doc_enum.position(),
+                                 "i = " << i << " p = " << p);
+            }
+            doc_enum.next_geq(plist.first.back() + 1);
+            BOOST_REQUIRE_EQUAL(coll.num_docs(), doc_enum.docid());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(tiny_lists_index)
+{
+    test_tiny_lists_index<ds2i::opt_index>(true);
+    test_tiny_lists_index<ds2i::block_optpfor_index>(true);
+    // all the lists are tiny, the base index is empty
+    test_tiny_lists_index<ds2i::block_optpfor_index>(false);
+}
@@ -0,0 +1,234 @@
+#define BOOST_TEST_MODULE two_tier_index
+
+#include "succinct/test_common.hpp"
+#include <boost/test/floating_point_comparison.hpp>
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+#include "ds2i_config.hpp"
+#include "index_types.hpp"
+#include "queries.hpp"
+
+#include <vector>
+#include <numeric>
+
+namespace ds2i { namespace test {
+
+    struct index_initialization {
+
+        typedef single_index base_index_type;
+        typedef two_tier_index<base_index_type> index_type;
+        typedef wand_data<>::scorer_type scorer_type;
+
+        static const uint64_t min_length = 100;
+
+        index_initialization()
+            : collection(DS2I_SOURCE_DIR "/test/test_data/test_collection")
+            , document_sizes(DS2I_SOURCE_DIR "/test/test_data/test_collection.sizes")
+            , wdata(document_sizes.begin()->begin(), collection.num_docs(), collection)
+        {
+            base_index_type::builder base_builder(collection.num_docs(), params);
+            index_type::builder builder(collection.num_docs(), params);
+            std::vector<float> weights;
+            for (auto const& plist: collection) {
+                uint64_t n = plist.docs.size();
+                uint64_t freqs_sum = std::accumulate(plist.freqs.begin(),
+                                                     plist.freqs.end(), uint64_t(0));
+                base_builder.add_posting_list(n, plist.docs.begin(),
+                                              plist.freqs.begin(), freqs_sum);
+                if (n < min_length) {
+                    builder.add_posting_list(n, plist.docs.begin(),
+                                             plist.freqs.begin(), freqs_sum);
+                    continue;
+                }
+                weights.resize(n);
+                for (uint64_t i = 0; i < n; ++i) {
+                    weights[i] = scorer_type::doc_term_weight
+                        (*(plist.freqs.begin() + i),
+                         wdata.norm_len(*(plist.docs.begin() + i)));
+                }
+                builder.add_posting_list(n, plist.docs.begin(), plist.freqs.begin(),
+                                         freqs_sum, weights.begin(), n / 10);
+            }
+            base_builder.build(base_index);
+            builder.build(index);
+
+            term_id_vec q;
+            std::ifstream qfile("test_data/queries");
+            while (read_query(q, qfile)) queries.push_back(q);
+        }
+
+        global_parameters params;
+        binary_freq_collection collection;
+        binary_collection document_sizes;
+        base_index_type base_index;
+        index_type index;
+        std::vector<term_id_vec> queries;
+        wand_data<> wdata;
+
+        template <typename QueryOp>
+        void test_against_or(QueryOp& op_q, docid_range const& range = docid_range()) const
+        {
+            ranked_or_query or_q(wdata, 10, std::numeric_limits<size_t>::max());
+
+            for (auto const& q: queries) {
+                or_q(base_index, q, range);
+                op_q(index, q, range);
+                BOOST_REQUIRE_EQUAL(or_q.topk().size(), op_q.topk().size());
+                for (size_t i = 0; i < or_q.topk().size(); ++i) {
+                    BOOST_REQUIRE_CLOSE(or_q.topk()[i].first, op_q.topk()[i].first, 0.1); // tolerance is % relative
+                }
+            }
+        }
+    };
+
+}}
+
+BOOST_FIXTURE_TEST_CASE(tiers,
+                        ds2i::test::index_initialization)
+{
+    BOOST_REQUIRE(index.num_split_lists() > 0);
+    uint64_t num_split = 0;
+    size_t s = 0;
+    for (auto const& plist: collection) {
+        auto e = index[s];
+        uint64_t n = plist.docs.size();
+        BOOST_REQUIRE_EQUAL(n, e.size());
+        BOOST_REQUIRE(n >= min_length || !e.is_split());
+        for (size_t i = 0; i < n; ++i, e.next()) {
+            MY_REQUIRE_EQUAL(i, e.position(), "s = " << s);
+            MY_REQUIRE_EQUAL(*(plist.docs.begin() + i), e.docid(),
+                             "s = " << s << " i = " << i);
+            MY_REQUIRE_EQUAL(*(plist.freqs.begin() + i), e.freq(),
+                             "s = " << s << " i = " << i);
+        }
+        BOOST_REQUIRE_EQUAL(index.num_docs(), e.docid());
+
+        if (e.is_split()) {
+            num_split += 1;
+            e.reset();
+            auto high = e.high_tier();
+            auto low = e.low_tier();
+            BOOST_REQUIRE_EQUAL(n / 10, high.size());
+            BOOST_REQUIRE_EQUAL(n - n / 10, low.size());
+
+            // the postings of the high tier weigh at least as much as
+            // those of the low tier, whose max weight is exact
+            float high_min = std::numeric_limits<float>::max(), high_max = 0;
+            for (; high.docid() < index.num_docs(); high.next()) {
+                float w = scorer_type::doc_term_weight
+                    (high.freq(), wdata.norm_len(high.docid()));
+                high_min = std::min(high_min, w);
+                high_max = std::max(high_max, w);
+            }
+            float low_max = 0;
+            for (; low.docid() < index.num_docs(); low.next()) {
+                low_max = std::max(low_max, scorer_type::doc_term_weight
+                                   (low.freq(), wdata.norm_len(low.docid())));
+            }
+            BOOST_REQUIRE_EQUAL(low_max, e.low_max_weight());
+            BOOST_REQUIRE(high_min >= low_max);
+            BOOST_REQUIRE_CLOSE(wdata.max_term_weight(s), high_max, 0.1);
+            BOOST_REQUIRE(low_max <= index_type::max_low_tier_ratio() * high_max);
+        } else if (n >= min_length) {
+            // the list is kept whole because the low tier would weigh too
+            // much to be skipped
+            std::vector<float> weights;
+            for (size_t i = 0; i < n; ++i) {
+                weights.push_back(scorer_type::doc_term_weight
+                                  (*(plist.freqs.begin() + i),
+                                   wdata.norm_len(*(plist.docs.begin() + i))));
+            }
+            std::sort(weights.begin(), weights.end(), std::greater<float>());
+            BOOST_REQUIRE(weights[n / 10] >
+                          index_type::max_low_tier_ratio() * weights[0]);
+        }
+
+        // next_geq on the union of the tiers
+        e.reset();
+        for (size_t i = 0; i < n; i += 7) {
+            uint64_t docid = *(plist.docs.begin() + i);
+            e.next_geq(docid);
+            MY_REQUIRE_EQUAL(docid, e.docid(), "s = " << s << " i = " << i);
+            MY_REQUIRE_EQUAL(*(plist.freqs.begin() + i), e.freq(),
+                             "s = " << s << " i = " << i);
+        }
+        s += 1;
+    }
+    BOOST_REQUIRE_EQUAL(num_split, index.num_split_lists());
+}
+
+BOOST_FIXTURE_TEST_CASE(unranked,
+                        ds2i::test::index_initialization)
+{
+    ds2i::and_query<true> and_q;
+    ds2i::or_query<true> or_q;
+    for (auto const& q: queries) {
+        BOOST_REQUIRE_EQUAL(and_q(base_index, q), and_q(index, q));
+        BOOST_REQUIRE_EQUAL(or_q(base_index, q), or_q(index, q));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(wand,
+                        ds2i::test::index_initialization)
+{
+    ds2i::wand_query wand_q(wdata, 10);
+    test_against_or(wand_q);
+    test_against_or(wand_q, ds2i::docid_range(1000, 5000));
+}
+
+BOOST_FIXTURE_TEST_CASE(maxscore,
+                        ds2i::test::index_initialization)
+{
+    ds2i::maxscore_query maxscore_q(wdata, 10);
+    test_against_or(maxscore_q);
+    test_against_or(maxscore_q, ds2i::docid_range(1000, 5000));
+}
+
+BOOST_FIXTURE_TEST_CASE(ranked_and,
+                        ds2i::test::index_initialization)
+{
+    ds2i::ranked_and_query base_q(wdata, 10);
+    ds2i::ranked_and_query two_tier_q(wdata, 10);
+    for (auto const& q: queries) {
+        base_q(base_index, q);
+        two_tier_q(index, q);
+        BOOST_REQUIRE_EQUAL(base_q.topk().size(), two_tier_q.topk().size());
+        for (size_t i = 0; i < base_q.topk().size(); ++i) {
+            BOOST_REQUIRE_CLOSE(base_q.topk()[i].first, two_tier_q.topk()[i].first, 0.1);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(push_tiers,
+                        ds2i::test::index_initialization)
+{
+    struct scored_enum {
+        index_type::document_enumerator docs_enum;
+        float q_weight;
+        float max_weight;
+    };
+
+    size_t s = 0;
+    for (; !index[s].is_split(); ++s);
+    auto list = index[s];
+    float q_weight = 2;
+    float low_max_weight = q_weight * list.low_max_weight();
+
+    // the low tier is traversed separately only if its max weight is
+    // well below the max weight of the term
+    std::vector<scored_enum> enums;
+    ds2i::push_tiers(index, index[s], q_weight, 2 * low_max_weight, enums);
+    BOOST_REQUIRE_EQUAL(2, enums.size());
+    BOOST_REQUIRE(!enums[0].docs_enum.is_split());
+    BOOST_REQUIRE_EQUAL(list.high_tier().size(), enums[0].docs_enum.size());
+    BOOST_REQUIRE_EQUAL(list.low_tier().size(), enums[1].docs_enum.size());
+    BOOST_REQUIRE_EQUAL(low_max_weight, enums[1].max_weight);
+
+    enums.clear();
+    ds2i::push_tiers(index, index[s], q_weight, 1.1 * low_max_weight, enums);
+    BOOST_REQUIRE_EQUAL(1, enums.size());
+    BOOST_REQUIRE(enums[0].docs_enum.is_split());
+    BOOST_REQUIRE_EQUAL(list.size(), enums[0].docs_enum.size());
+}
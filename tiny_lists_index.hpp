@@ -0,0 +1,323 @@
+#pragma once
+
+#include <boost/optional.hpp>
+
+#include <succinct/mappable_vector.hpp>
+#include <succinct/bit_vector.hpp>
+
+#include "compact_elias_fano.hpp"
+#include "block_codecs.hpp"
+#include "global_parameters.hpp"
+
+namespace ds2i {
+
+    // Wraps an index storing the lists with at most MaxTinySize postings
+    // inline in a term directory, so that they do not pay for the
+    // per-list headers and encodings of BaseIndex, and opening them never
+    // touches the main data. The term ids of the tiny lists are stored in
+    // an Elias-Fano sequence: the rank of a term among them gives both
+    // its directory entry and, by difference, its id in BaseIndex. Each
+    // entry is vbyte-encoded as n, first docid, docid gaps minus one,
+    // freqs minus one.
+    template <typename BaseIndex, size_t MaxTinySize = 3>
+    class tiny_lists_index {
+    public:
+        static const size_t max_tiny_size = MaxTinySize;
+
+        tiny_lists_index()
+            : m_size(0)
+            , m_num_docs(0)
+            , m_num_tiny(0)
+        {}
+
+        class builder {
+        public:
+            builder(uint64_t num_docs, global_parameters const& params)
+                : m_params(params)
+                , m_num_docs(num_docs)
+                , m_size(0)
+                , m_num_base(0)
+                , m_base_builder(num_docs, params)
+            {
+                m_tiny_endpoints.push_back(0);
+            }
+
+            template <typename DocsIterator, typename FreqsIterator>
+            void add_posting_list(uint64_t n, DocsIterator docs_begin,
+                                  FreqsIterator freqs_begin, uint64_t occurrences)
+            {
+                if (!n) throw std::invalid_argument("List must be nonempty");
+
+                if (n <= max_tiny_size) {
+                    TightVariableByte::encode_single(n, m_tiny_lists);
+                    DocsIterator docs_it = docs_begin;
+                    uint64_t last_doc = 0;
+                    for (size_t i = 0; i < n; ++i) {
+                        uint64_t doc = *docs_it++;
+                        if (i && doc <= last_doc) {
+                            throw std::invalid_argument("Sequence is not strictly increasing");
+                        }
+                        TightVariableByte::encode_single(i ? doc - last_doc - 1 : doc,
+                                                         m_tiny_lists);
+                        last_doc = doc;
+                    }
+                    FreqsIterator freqs_it = freqs_begin;
+                    for (size_t i = 0; i < n; ++i) {
+                        uint64_t freq = *freqs_it++;
+                        if (!freq) throw std::invalid_argument("Freqs must be positive");
+                        TightVariableByte::encode_single(freq - 1, m_tiny_lists);
+                    }
+                    m_tiny_ids.push_back(m_size);
+                    m_tiny_endpoints.push_back(m_tiny_lists.size());
+                } else {
+                    m_base_builder.add_posting_list(n, docs_begin, freqs_begin,
+                                                    occurrences);
+                    m_num_base += 1;
+                }
+                m_size += 1;
+            }
+
+            void build(tiny_lists_index& sq)
+            {
+                sq.m_params = m_params;
+                sq.m_size = m_size;
+                sq.m_num_docs = m_num_docs;
+                sq.m_num_tiny = m_tiny_ids.size();
+                sq.m_tiny_lists.steal(m_tiny_lists);
+
+                if (sq.m_num_tiny) {
+                    succinct::bit_vector_builder ids_bvb;
+                    compact_elias_fano::write(ids_bvb, m_tiny_ids.begin(),
+                                              m_size, sq.m_num_tiny,
+                                              m_params);
+                    succinct::bit_vector(&ids_bvb).swap(sq.m_tiny_ids);
+
+                    succinct::bit_vector_builder endpoints_bvb;
+                    compact_elias_fano::write(endpoints_bvb, m_tiny_endpoints.begin(),
+                                              sq.m_tiny_lists.size(), sq.m_num_tiny,
+                                              m_params);
+                    succinct::bit_vector(&endpoints_bvb).swap(sq.m_tiny_endpoints);
+                }
+
+                // an empty base index is left default-constructed
+                if (m_num_base) {
+                    m_base_builder.build(sq.m_base);
+                }
+            }
+
+        private:
+            global_parameters m_params;
+            uint64_t m_num_docs;
+            uint64_t m_size;
+            uint64_t m_num_base;
+            typename BaseIndex::builder m_base_builder;
+            std::vector<uint64_t> m_tiny_ids;
+            std::vector<uint64_t> m_tiny_endpoints;
+            std::vector<uint8_t> m_tiny_lists;
+        };
+
+        size_t size() const
+        {
+            return m_size;
+        }
+
+        uint64_t num_docs() const
+        {
+            return m_num_docs;
+        }
+
+        uint64_t num_tiny_lists() const
+        {
+            return m_num_tiny;
+        }
+
+        BaseIndex const& base() const
+        {
+            return m_base;
+        }
+
+        BaseIndex& base()
+        {
+            return m_base;
+        }
+
+        typedef typename BaseIndex::document_enumerator base_enumerator;
+
+        class document_enumerator {
+        public:
+            void reset()
+            {
+                if (m_base_enum) {
+                    m_base_enum->reset();
+                } else {
+                    m_pos = 0;
+                }
+            }
+
+            void DS2I_ALWAYSINLINE next()
+            {
+                if (DS2I_LIKELY(bool(m_base_enum))) {
+                    m_base_enum->next();
+                } else {
+                    ++m_pos;
+                }
+            }
+
+            void DS2I_ALWAYSINLINE next_geq(uint64_t lower_bound)
+            {
+                if (DS2I_LIKELY(bool(m_base_enum))) {
+                    m_base_enum->next_geq(lower_bound);
+                } else {
+                    while (m_pos < m_n && m_docs[m_pos] < lower_bound) {
+                        ++m_pos;
+                    }
+                }
+            }
+
+            void DS2I_ALWAYSINLINE move(uint64_t position)
+            {
+                if (DS2I_LIKELY(bool(m_base_enum))) {
+                    m_base_enum->move(position);
+                } else {
+                    m_pos = position;
+                }
+            }
+
+            uint64_t docid() const
+            {
+                return m_base_enum ? m_base_enum->docid() : m_docs[m_pos];
+            }
+
+            uint64_t DS2I_ALWAYSINLINE freq()
+            {
+                return m_base_enum ? m_base_enum->freq() : m_freqs[m_pos];
+            }
+
+            uint64_t position() const
+            {
+                return m_base_enum ? m_base_enum->position() : m_pos;
+            }
+
+            uint64_t size() const
+            {
+                return m_base_enum ? m_base_enum->size() : m_n;
+            }
+
+            bool is_tiny() const
+            {
+                return !m_base_enum;
+            }
+
+        private:
+            friend class tiny_lists_index;
+
+            document_enumerator(base_enumerator const& base_enum)
+                : m_base_enum(base_enum)
+                , m_n(0)
+                , m_pos(0)
+            {}
+
+            document_enumerator(uint8_t const* data, uint64_t num_docs)
+                : m_pos(0)
+            {
+                uint32_t buf[2 * max_tiny_size + 1];
+                data = TightVariableByte::decode(data, buf, 1);
+                m_n = buf[0];
+                assert(m_n > 0 && m_n <= max_tiny_size);
+                TightVariableByte::decode(data, buf, 2 * m_n);
+
+                uint64_t doc = buf[0];
+                m_docs[0] = doc;
+                m_freqs[0] = buf[m_n] + 1;
+                for (size_t i = 1; i < m_n; ++i) {
+                    doc += buf[i] + 1;
+                    m_docs[i] = doc;
+                    m_freqs[i] = buf[m_n + i] + 1;
+                }
+                // sentinel, as docid() past the end returns the universe
+                m_docs[m_n] = num_docs;
+                m_freqs[m_n] = 0;
+            }
+
+            boost::optional<base_enumerator> m_base_enum;
+            uint64_t m_n;
+            uint64_t m_pos;
+            uint64_t m_docs[max_tiny_size + 1];
+            uint64_t m_freqs[max_tiny_size + 1];
+        };
+
+        document_enumerator operator[](size_t i) const
+        {
+            assert(i < size());
+            uint64_t rank = 0;
+            if (m_num_tiny) {
+                auto tiny = tiny_ids_enum().next_geq(i);
+                if (tiny.second == i) {
+                    compact_elias_fano::enumerator endpoints(m_tiny_endpoints, 0,
+                                                             m_tiny_lists.size(),
+                                                             m_num_tiny, m_params);
+                    auto endpoint = endpoints.move(tiny.first).second;
+                    return document_enumerator(m_tiny_lists.data() + endpoint,
+                                               num_docs());
+                }
+                rank = tiny.first;
+            }
+            return document_enumerator(m_base[i - rank]);
+        }
+
+        void warmup(size_t i) const
+        {
+            assert(i < size());
+            uint64_t rank = 0;
+            if (m_num_tiny) {
+                auto tiny = tiny_ids_enum().next_geq(i);
+                if (tiny.second == i) return;
+                rank = tiny.first;
+            }
+            m_base.warmup(i - rank);
+        }
+
+        void swap(tiny_lists_index& other)
+        {
+            std::swap(m_params, other.m_params);
+            std::swap(m_size, other.m_size);
+            std::swap(m_num_docs, other.m_num_docs);
+            std::swap(m_num_tiny, other.m_num_tiny);
+            m_tiny_ids.swap(other.m_tiny_ids);
+            m_tiny_endpoints.swap(other.m_tiny_endpoints);
+            m_tiny_lists.swap(other.m_tiny_lists);
+            m_base.swap(other.m_base);
+        }
+
+        template <typename Visitor>
+        void map(Visitor& visit)
+        {
+            visit
+                (m_params, "m_params")
+                (m_size, "m_size")
+                (m_num_docs, "m_num_docs")
+                (m_num_tiny, "m_num_tiny")
+                (m_tiny_ids, "m_tiny_ids")
+                (m_tiny_endpoints, "m_tiny_endpoints")
+                (m_tiny_lists, "m_tiny_lists")
+                (m_base, "m_base")
+                ;
+        }
+
+    private:
+        compact_elias_fano::enumerator tiny_ids_enum() const
+        {
+            return compact_elias_fano::enumerator(m_tiny_ids, 0, m_size,
+                                                  m_num_tiny, m_params);
+        }
+
+        global_parameters m_params;
+        uint64_t m_size;
+        uint64_t m_num_docs;
+        uint64_t m_num_tiny;
+        succinct::bit_vector m_tiny_ids;
+        succinct::bit_vector m_tiny_endpoints;
+        succinct::mapper::mappable_vector<uint8_t> m_tiny_lists;
+        BaseIndex m_base;
+    };
+}
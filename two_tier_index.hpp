@@ -0,0 +1,414 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <numeric>
+
+#include <boost/optional.hpp>
+
+#include <succinct/bit_vector.hpp>
+#include <succinct/mappable_vector.hpp>
+
+#include "compact_elias_fano.hpp"
+#include "global_parameters.hpp"
+#include "util.hpp"
+
+namespace ds2i {
+
+    // Splits the long posting lists in two tiers: a short high tier with
+    // the postings of highest weight, and the remainder in a low tier with
+    // its own max weight. The weight of a posting is its doc_term_weight,
+    // as in the max weights of wand_data, so the max weight of the high
+    // tier is the max weight of the term, and the low tier has a tighter
+    // one. The high tiers (and the lists that are not split) are stored
+    // in a BaseIndex by term id, the low tiers in another BaseIndex; as
+    // in hybrid_lists_index, the term ids of the split lists are stored
+    // in an Elias-Fano sequence, whose rank gives the ids of the low
+    // tiers.
+    //
+    // The document_enumerator iterates over the union of the two tiers,
+    // so that all the query operators work unchanged; WAND and maxscore
+    // instead traverse the two tiers as separate lists (see push_tiers
+    // in queries.hpp), so that the low tier, which holds most of the
+    // postings, is skipped once the threshold exceeds its max weight.
+    // This pays off only if the max weight of the low tier is at most
+    // max_low_tier_ratio() times the max weight of the term, so the other
+    // lists are not split, and traversed as plain lists.
+    template <typename BaseIndex>
+    class two_tier_index {
+    public:
+        typedef BaseIndex base_index_type;
+
+        static float max_low_tier_ratio()
+        {
+            return 0.6;
+        }
+
+        two_tier_index()
+            : m_size(0)
+            , m_num_docs(0)
+            , m_num_split(0)
+        {}
+
+        class builder {
+        public:
+            builder(uint64_t num_docs, global_parameters const& params)
+                : m_params(params)
+                , m_num_docs(num_docs)
+                , m_size(0)
+                , m_high_builder(num_docs, params)
+                , m_low_builder(num_docs, params)
+            {}
+
+            // Adds the list without splitting it
+            template <typename DocsIterator, typename FreqsIterator>
+            void add_posting_list(uint64_t n, DocsIterator docs_begin,
+                                  FreqsIterator freqs_begin, uint64_t occurrences)
+            {
+                if (!n) throw std::invalid_argument("List must be nonempty");
+                m_high_builder.add_posting_list(n, docs_begin, freqs_begin,
+                                                occurrences);
+                m_size += 1;
+            }
+
+            // Puts the high_size postings with the highest weight in the
+            // high tier, and the others in the low tier. The list is not
+            // split if either tier would be empty, or if the max weight of
+            // the low tier is above max_low_tier_ratio() times the max
+            // weight; returns true if the list is split
+            template <typename DocsIterator, typename FreqsIterator,
+                      typename WeightsIterator>
+            bool add_posting_list(uint64_t n, DocsIterator docs_begin,
+                                  FreqsIterator freqs_begin, uint64_t occurrences,
+                                  WeightsIterator weights_begin, uint64_t high_size)
+            {
+                if (!n) throw std::invalid_argument("List must be nonempty");
+                if (!high_size || high_size >= n) {
+                    add_posting_list(n, docs_begin, freqs_begin, occurrences);
+                    return false;
+                }
+
+                std::vector<float> weights(n);
+                for (uint64_t i = 0; i < n; ++i) {
+                    weights[i] = *weights_begin++;
+                }
+                // ties are broken by position, so the split is deterministic
+                std::vector<uint64_t> order(n);
+                std::iota(order.begin(), order.end(), uint64_t(0));
+                std::nth_element(order.begin(), order.begin() + (high_size - 1),
+                                 order.end(), [&](uint64_t lhs, uint64_t rhs) {
+                                     return weights[lhs] > weights[rhs] ||
+                                         (weights[lhs] == weights[rhs] && lhs < rhs);
+                                 });
+                float max_weight = *std::max_element(weights.begin(), weights.end());
+                float low_max_weight = 0;
+                for (uint64_t i = high_size; i < n; ++i) {
+                    low_max_weight = std::max(low_max_weight, weights[order[i]]);
+                }
+                if (low_max_weight > max_low_tier_ratio() * max_weight) {
+                    add_posting_list(n, docs_begin, freqs_begin, occurrences);
+                    return false;
+                }
+
+                std::vector<bool> in_high(n);
+                for (uint64_t i = 0; i < high_size; ++i) {
+                    in_high[order[i]] = true;
+                }
+
+                // the builder of freq_index encodes the lists
+                // asynchronously, so the iterators of the tiers own their
+                // buffers
+                buffer_ptr high_docs(new std::vector<uint64_t>);
+                buffer_ptr high_freqs(new std::vector<uint64_t>);
+                buffer_ptr low_docs(new std::vector<uint64_t>);
+                buffer_ptr low_freqs(new std::vector<uint64_t>);
+                uint64_t high_occurrences = 0, low_occurrences = 0;
+                for (uint64_t i = 0; i < n; ++i) {
+                    uint64_t docid = *docs_begin++;
+                    uint64_t freq = *freqs_begin++;
+                    if (in_high[i]) {
+                        high_docs->push_back(docid);
+                        high_freqs->push_back(freq);
+                        high_occurrences += freq;
+                    } else {
+                        low_docs->push_back(docid);
+                        low_freqs->push_back(freq);
+                        low_occurrences += freq;
+                    }
+                }
+                assert(high_occurrences + low_occurrences == occurrences);
+                (void)occurrences;
+
+                auto buffer_begin = [](buffer_ptr const& buf) {
+                    return make_function_iterator
+                        (std::make_pair(buf, size_t(0)),
+                         [](std::pair<buffer_ptr, size_t>& state) {
+                             ++state.second;
+                         }, [](std::pair<buffer_ptr, size_t> const& state) {
+                             return (*state.first)[state.second];
+                         });
+                };
+
+                m_high_builder.add_posting_list(high_size, buffer_begin(high_docs),
+                                                buffer_begin(high_freqs),
+                                                high_occurrences);
+                m_low_builder.add_posting_list(n - high_size, buffer_begin(low_docs),
+                                               buffer_begin(low_freqs),
+                                               low_occurrences);
+                m_split_ids.push_back(m_size);
+                m_low_max_weights.push_back(low_max_weight);
+                m_size += 1;
+                return true;
+            }
+
+            void build(two_tier_index& sq)
+            {
+                sq.m_params = m_params;
+                sq.m_size = m_size;
+                sq.m_num_docs = m_num_docs;
+                sq.m_num_split = m_split_ids.size();
+                sq.m_low_max_weights.steal(m_low_max_weights);
+
+                if (sq.m_num_split) {
+                    succinct::bit_vector_builder ids_bvb;
+                    compact_elias_fano::write(ids_bvb, m_split_ids.begin(),
+                                              m_size, sq.m_num_split,
+                                              m_params);
+                    succinct::bit_vector(&ids_bvb).swap(sq.m_split_ids);
+                }
+
+                // empty indexes are left default-constructed
+                if (m_size) {
+                    m_high_builder.build(sq.m_high);
+                }
+                if (sq.m_num_split) {
+                    m_low_builder.build(sq.m_low);
+                }
+            }
+
+        private:
+            typedef std::shared_ptr<std::vector<uint64_t>> buffer_ptr;
+
+            global_parameters m_params;
+            uint64_t m_num_docs;
+            uint64_t m_size;
+            typename BaseIndex::builder m_high_builder;
+            typename BaseIndex::builder m_low_builder;
+            std::vector<uint64_t> m_split_ids;
+            std::vector<float> m_low_max_weights;
+        };
+
+        size_t size() const
+        {
+            return m_size;
+        }
+
+        uint64_t num_docs() const
+        {
+            return m_num_docs;
+        }
+
+        uint64_t num_split_lists() const
+        {
+            return m_num_split;
+        }
+
+        BaseIndex const& high() const
+        {
+            return m_high;
+        }
+
+        BaseIndex& high()
+        {
+            return m_high;
+        }
+
+        BaseIndex const& low() const
+        {
+            return m_low;
+        }
+
+        BaseIndex& low()
+        {
+            return m_low;
+        }
+
+        typedef typename BaseIndex::document_enumerator base_enumerator;
+
+        class document_enumerator {
+        public:
+            void reset()
+            {
+                m_high.reset();
+                if (m_low) m_low->reset();
+                update_current();
+            }
+
+            void DS2I_ALWAYSINLINE next()
+            {
+                if (m_in_low) {
+                    m_low->next();
+                } else {
+                    m_high.next();
+                }
+                update_current();
+            }
+
+            void DS2I_ALWAYSINLINE next_geq(uint64_t lower_bound)
+            {
+                if (!m_low) {
+                    m_high.next_geq(lower_bound);
+                    return;
+                }
+                // the tier that is already past lower_bound stays put
+                if (m_high.docid() < lower_bound) m_high.next_geq(lower_bound);
+                if (m_low->docid() < lower_bound) m_low->next_geq(lower_bound);
+                update_current();
+            }
+
+            uint64_t docid() const
+            {
+                return m_in_low ? m_low->docid() : m_high.docid();
+            }
+
+            uint64_t DS2I_ALWAYSINLINE freq()
+            {
+                return m_in_low ? m_low->freq() : m_high.freq();
+            }
+
+            uint64_t position() const
+            {
+                return m_high.position() + (m_low ? m_low->position() : 0);
+            }
+
+            uint64_t size() const
+            {
+                return m_high.size() + (m_low ? m_low->size() : 0);
+            }
+
+            bool is_split() const
+            {
+                return bool(m_low);
+            }
+
+            // The tiers of a split list, as single-tier enumerators at the
+            // current position
+            document_enumerator high_tier() const
+            {
+                assert(is_split());
+                return document_enumerator(m_high);
+            }
+
+            document_enumerator low_tier() const
+            {
+                assert(is_split());
+                return document_enumerator(*m_low);
+            }
+
+            // The max doc_term_weight of the low tier
+            float low_max_weight() const
+            {
+                return m_low_max_weight;
+            }
+
+        private:
+            friend class two_tier_index;
+
+            document_enumerator(base_enumerator const& high)
+                : m_high(high)
+                , m_low_max_weight(0)
+                , m_in_low(false)
+            {}
+
+            document_enumerator(base_enumerator const& high,
+                                base_enumerator const& low,
+                                float low_max_weight)
+                : m_high(high)
+                , m_low(low)
+                , m_low_max_weight(low_max_weight)
+            {
+                update_current();
+            }
+
+            // the current posting is the one with the lowest docid among
+            // the tiers
+            void DS2I_ALWAYSINLINE update_current()
+            {
+                m_in_low = m_low && m_low->docid() < m_high.docid();
+            }
+
+            base_enumerator m_high;
+            boost::optional<base_enumerator> m_low;
+            float m_low_max_weight;
+            bool m_in_low;
+        };
+
+        document_enumerator operator[](size_t i) const
+        {
+            assert(i < size());
+            if (m_num_split) {
+                auto split = split_ids_enum().next_geq(i);
+                if (split.second == i) {
+                    return document_enumerator(m_high[i], m_low[split.first],
+                                               m_low_max_weights[split.first]);
+                }
+            }
+            return document_enumerator(m_high[i]);
+        }
+
+        void warmup(size_t i) const
+        {
+            assert(i < size());
+            m_high.warmup(i);
+            if (m_num_split) {
+                auto split = split_ids_enum().next_geq(i);
+                if (split.second == i) {
+                    m_low.warmup(split.first);
+                }
+            }
+        }
+
+        void swap(two_tier_index& other)
+        {
+            std::swap(m_params, other.m_params);
+            std::swap(m_size, other.m_size);
+            std::swap(m_num_docs, other.m_num_docs);
+            std::swap(m_num_split, other.m_num_split);
+            m_split_ids.swap(other.m_split_ids);
+            m_low_max_weights.swap(other.m_low_max_weights);
+            m_high.swap(other.m_high);
+            m_low.swap(other.m_low);
+        }
+
+        template <typename Visitor>
+        void map(Visitor& visit)
+        {
+            visit
+                (m_params, "m_params")
+                (m_size, "m_size")
+                (m_num_docs, "m_num_docs")
+                (m_num_split, "m_num_split")
+                (m_split_ids, "m_split_ids")
+                (m_low_max_weights, "m_low_max_weights")
+                (m_high, "m_high")
+                (m_low, "m_low")
+                ;
+        }
+
+    private:
+        compact_elias_fano::enumerator split_ids_enum() const
+        {
+            return compact_elias_fano::enumerator(m_split_ids, 0, m_size,
+                                                  m_num_split, m_params);
+        }
+
+        global_parameters m_params;
+        uint64_t m_size;
+        uint64_t m_num_docs;
+        uint64_t m_num_split;
+        succinct::bit_vector m_split_ids;
+        succinct::mapper::mappable_vector<float> m_low_max_weights;
+        BaseIndex m_high;
+        BaseIndex m_low;
+    };
+}
@@ -210,6 +210,18 @@ namespace ds2i {
                 }
             }
 
+            // The enumerator of the current partition, and the position
+            // where the partition ends
+            base_sequence_enumerator const& partition_enum() const
+            {
+                return m_partition_enum;
+            }
+
+            uint64_t partition_end() const
+            {
+                return m_cur_end;
+            }
+
         private:
 
             // the compiler does not seem smart enough to figure out that this
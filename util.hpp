@@ -9,6 +9,10 @@
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/time.h>
 #include <sys/resource.h>
 
@@ -60,6 +64,21 @@ namespace ds2i {
         return double(ru.ru_utime.tv_sec) * 1000000 + double(ru.ru_utime.tv_usec);
     }
 
+    // Forces the data of a file, or the entries of a directory, to
+    // disk, so that they survive a crash of the machine
+    inline void sync_file(std::string const& filename)
+    {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open " + filename + " to sync it");
+        }
+        int ret = ::fsync(fd);
+        ::close(fd);
+        if (ret) {
+            throw std::runtime_error("Cannot sync " + filename);
+        }
+    }
+
     // stolen from folly
     template <class T>
     inline void do_not_optimize_away(T&& datum) {
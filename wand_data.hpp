@@ -11,6 +11,9 @@ namespace ds2i {
     template <typename Scorer = bm25>
     class wand_data {
     public:
+        typedef Scorer scorer_type;
+        typedef float doc_norms_type;
+
         wand_data()
         {}
 
@@ -62,6 +65,19 @@ namespace ds2i {
             return m_max_term_weight[term_id];
         }
 
+        // What the query operators need to score the postings of a
+        // document; here it is just its normalized length
+        doc_norms_type doc_norms(uint64_t doc_id) const
+        {
+            return norm_len(doc_id);
+        }
+
+        template <typename Enumerator>
+        float doc_term_weight(Enumerator& e, doc_norms_type len) const
+        {
+            return Scorer::doc_term_weight(e.freq(), len);
+        }
+
         void swap(wand_data& other)
         {
             m_norm_lens.swap(other.m_norm_lens);